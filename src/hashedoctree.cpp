@@ -0,0 +1,411 @@
+ /***********************************************************************************
+ #   This file is part of octree.                                                   #
+ #                                                                                  #
+ #   MIT License                                                                    #
+ #                                                                                  #
+ #   Copyright (c) 2018 Ivo Filot <ivo@ivofilot.nl>                                 #
+ #                                                                                  #
+ #   Permission is hereby granted, free of charge, to any person obtaining a copy   #
+ #   of this software and associated documentation files (the "Software"), to deal  #
+ #   in the Software without restriction, including without limitation the rights   #
+ #   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell      #
+ #   copies of the Software, and to permit persons to whom the Software is          #
+ #   furnished to do so, subject to the following conditions:                       #
+ #                                                                                  #
+ #   The above copyright notice and this permission notice shall be included in all #
+ #   copies or substantial portions of the Software.                                #
+ #                                                                                  #
+ #   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR     #
+ #   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,       #
+ #   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE    #
+ #   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER         #
+ #   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  #
+ #   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  #
+ #   SOFTWARE.                                                                      #
+ #                                                                                  #
+ #***********************************************************************************/
+
+
+#include "hashedoctree.h"
+
+#ifndef _HASHEDOCTREE_IMPL
+#define _HASHEDOCTREE_IMPL
+
+/**
+ * @brief      Hashed octree constructor
+ *
+ * @param[in]  _x    width of principal cell
+ * @param[in]  _y    breadth of principal cell
+ * @param[in]  _z    height of principal cell
+ */
+template <class T>
+HashedOctree<T>::HashedOctree(double _x, double _y, double _z) :
+    ox(0.0),
+    oy(0.0),
+    oz(0.0),
+    x(_x),
+    y(_y),
+    z(_z) {
+
+    this->slots.resize(1 << 10);
+    this->shift = 64 - 10;
+    this->insert(1);
+}
+
+/**
+ * @brief      add object to the tree
+ *
+ * @param      object  pointer to object
+ * @param[in]  _px     x position
+ * @param[in]  _py     y position
+ * @param[in]  _pz     z position
+ */
+template <class T>
+void HashedOctree<T>::add(T* object, double _px, double _py, double _pz) {
+    HashedOctreeNode<T>* node = this->find_node(_px, _py, _pz);
+
+    node->objects.push_back(object);
+    node->pos.push_back(_px);
+    node->pos.push_back(_py);
+    node->pos.push_back(_pz);
+
+    if(node->objects.size() >= 16) {
+        this->split(node);
+    }
+}
+
+/**
+ * @brief      find the leaf containing a position
+ *
+ * Performs a binary search over the levels, which is possible because
+ * all ancestors of a node are present in the table.
+ *
+ * @param[in]  _px   x position
+ * @param[in]  _py   y position
+ * @param[in]  _pz   z position
+ *
+ * @return     pointer to node
+ */
+template <class T>
+HashedOctreeNode<T>* HashedOctree<T>::find_node(double _px, double _py, double _pz) const {
+    const uint64_t m = this->point_key(_px, _py, _pz);
+
+    unsigned int lo = 0;
+    unsigned int hi = this->depth;
+    while(lo < hi) {
+        const unsigned int mid = (lo + hi + 1) / 2;
+        const uint64_t key = (1ull << (3 * mid)) | (m >> (3 * (max_level - mid)));
+        if(this->get_node(key) != nullptr) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return this->get_node((1ull << (3 * lo)) | (m >> (3 * (max_level - lo))));
+}
+
+/**
+ * @brief      get node given its locational code
+ *
+ * @param[in]  key   locational code
+ *
+ * @return     pointer to node or nullptr if not present
+ */
+template <class T>
+HashedOctreeNode<T>* HashedOctree<T>::get_node(uint64_t key) const {
+    const size_t mask = this->slots.size() - 1;
+    for(size_t s = this->hash(key); ; s = (s + 1) & mask) {
+        if(this->slots[s].key == key) {
+            return this->slots[s].node;
+        }
+        if(this->slots[s].key == 0) {
+            return nullptr;
+        }
+    }
+}
+
+/**
+ * @brief      find neighbor (equal or larger in size) in direction i
+ *
+ * @param[in]  node  pointer to node
+ * @param[in]  i     direction i (OT_D_*)
+ *
+ * @return     pointer to neighbor or nullptr at the domain boundary
+ */
+template <class T>
+HashedOctreeNode<T>* HashedOctree<T>::find_gteq_neighbor(const HashedOctreeNode<T>* node, unsigned int i) const {
+    constexpr const OctreeTables<3>& tables = octree_tables<3>;
+
+    const unsigned int level = key_level(node->key);
+    const uint64_t sentinel = 1ull << (3 * level);
+    const int64_t n = (int64_t)1 << level;
+
+    uint32_t ix, iy, iz;
+    decode(node->key ^ sentinel, &ix, &iy, &iz);
+
+    const int64_t nx = (int64_t)ix + tables.offset(i, 0);
+    const int64_t ny = (int64_t)iy + tables.offset(i, 1);
+    const int64_t nz = (int64_t)iz + tables.offset(i, 2);
+    if(nx < 0 || ny < 0 || nz < 0 || nx >= n || ny >= n || nz >= n) {
+        return nullptr;
+    }
+
+    // climb towards the root until an existing node is found
+    uint64_t key = sentinel | encode((uint32_t)nx, (uint32_t)ny, (uint32_t)nz);
+    HashedOctreeNode<T>* q = this->get_node(key);
+    while(q == nullptr) {
+        key >>= 3;
+        q = this->get_node(key);
+    }
+
+    return q;
+}
+
+/**
+ * @brief      find neighbors
+ *
+ * @param[in]  node  pointer to node
+ *
+ * @return     vector holding pointers to neighbor nodes
+ */
+template <class T>
+std::vector<HashedOctreeNode<T>*> HashedOctree<T>::find_neighbors(const HashedOctreeNode<T>* node) const {
+    std::vector<HashedOctreeNode<T>*> neighbors;
+    neighbors.reserve(26);
+
+    for(unsigned int i=0; i<26; i++) {
+        HashedOctreeNode<T>* q = this->find_gteq_neighbor(node, i);
+        if(q != nullptr && std::find(neighbors.begin(), neighbors.end(), q) == neighbors.end()) {
+            neighbors.push_back(q);
+        }
+    }
+
+    return neighbors;
+}
+
+/**
+ * @brief      get the center of a node
+ *
+ * @param[in]  node  pointer to node
+ * @param[out] _cx   center x
+ * @param[out] _cy   center y
+ * @param[out] _cz   center z
+ */
+template <class T>
+void HashedOctree<T>::get_center(const HashedOctreeNode<T>* node, double* _cx, double* _cy, double* _cz) const {
+    const unsigned int level = key_level(node->key);
+    const double n = (double)((uint64_t)1 << level);
+
+    uint32_t ix, iy, iz;
+    decode(node->key ^ (1ull << (3 * level)), &ix, &iy, &iz);
+
+    *_cx = this->ox + (ix + 0.5) * this->x / n;
+    *_cy = this->oy + (iy + 0.5) * this->y / n;
+    *_cz = this->oz + (iz + 0.5) * this->z / n;
+}
+
+/**
+ * @brief      get the level of a locational code
+ *
+ * @param[in]  key   locational code
+ *
+ * @return     level
+ */
+template <class T>
+unsigned int HashedOctree<T>::key_level(uint64_t key) {
+#if defined(__GNUC__)
+    return (63 - __builtin_clzll(key)) / 3;
+#else
+    unsigned int level = 0;
+    while(key >>= 3) {
+        level++;
+    }
+    return level;
+#endif
+}
+
+/**
+ * @brief      split a leaf into 8 octants
+ *
+ * @param      node  pointer to node
+ */
+template <class T>
+void HashedOctree<T>::split(HashedOctreeNode<T>* node) {
+    const unsigned int level = key_level(node->key);
+    if(!node->leaf || level >= max_level) {
+        return;
+    }
+
+    node->leaf = false;
+
+    HashedOctreeNode<T>* children[8];
+    for(unsigned int o=0; o<8; o++) {
+        children[o] = this->insert((node->key << 3) | o);
+    }
+    this->depth = std::max(this->depth, level + 1);
+
+    // migrate objects
+    const unsigned int s = 3 * (max_level - level - 1);
+    for(unsigned int i=0; i<node->objects.size(); i++) {
+        const double* p = &node->pos[i*3];
+        HashedOctreeNode<T>* child = children[(this->point_key(p[0], p[1], p[2]) >> s) & 7];
+        child->objects.push_back(node->objects[i]);
+        child->pos.insert(child->pos.end(), p, p + 3);
+    }
+
+    node->objects.clear();
+    node->pos.clear();
+    node->objects.shrink_to_fit();
+    node->pos.shrink_to_fit();
+
+    for(unsigned int o=0; o<8; o++) {
+        if(children[o]->objects.size() >= 16) {
+            this->split(children[o]);
+        }
+    }
+}
+
+/**
+ * @brief      insert a new node in the table
+ *
+ * @param[in]  key   locational code
+ *
+ * @return     pointer to the new node
+ */
+template <class T>
+HashedOctreeNode<T>* HashedOctree<T>::insert(uint64_t key) {
+    // keep the load factor below 1/2
+    if(2 * (this->nodes.size() + 1) > this->slots.size()) {
+        this->grow();
+    }
+
+    this->nodes.emplace_back(key);
+    HashedOctreeNode<T>* node = &this->nodes.back();
+
+    const size_t mask = this->slots.size() - 1;
+    size_t s = this->hash(key);
+    while(this->slots[s].key != 0) {
+        s = (s + 1) & mask;
+    }
+    this->slots[s].key = key;
+    this->slots[s].node = node;
+
+    return node;
+}
+
+/**
+ * @brief      double the size of the table and rehash all nodes
+ */
+template <class T>
+void HashedOctree<T>::grow() {
+    std::vector<Slot> old(this->slots.size() * 2);
+    std::swap(old, this->slots);
+    this->shift--;
+
+    const size_t mask = this->slots.size() - 1;
+    for(const Slot& slot : old) {
+        if(slot.key == 0) {
+            continue;
+        }
+        size_t s = this->hash(slot.key);
+        while(this->slots[s].key != 0) {
+            s = (s + 1) & mask;
+        }
+        this->slots[s] = slot;
+    }
+}
+
+/**
+ * @brief      get the key at the deepest level for a position
+ *
+ * @param[in]  _px   x position
+ * @param[in]  _py   y position
+ * @param[in]  _pz   z position
+ *
+ * @return     Morton key (without sentinel bit) at max_level
+ */
+template <class T>
+uint64_t HashedOctree<T>::point_key(double _px, double _py, double _pz) const {
+    return encode(grid(_px, this->ox, this->x),
+                  grid(_py, this->oy, this->y),
+                  grid(_pz, this->oz, this->z));
+}
+
+/**
+ * @brief      convert coordinate to integer grid at max_level
+ *
+ * @param[in]  p     position
+ * @param[in]  o     origin
+ * @param[in]  l     length of the domain
+ *
+ * @return     integer coordinate
+ */
+template <class T>
+uint32_t HashedOctree<T>::grid(double p, double o, double l) {
+    const double n = (double)(1u << max_level);
+    const double t = (p - o) / l * n;
+
+    if(t < 0.0) {
+        return 0;
+    }
+    if(t >= n) {
+        return (1u << max_level) - 1;
+    }
+
+    return (uint32_t)t;
+}
+
+/**
+ * @brief      interleave integer coordinates into a Morton key
+ *
+ * The bits are interleaved as (x, z, y) from high to low such that each
+ * triplet equals the OT_* octant label.
+ *
+ * @param[in]  ix    integer x
+ * @param[in]  iy    integer y
+ * @param[in]  iz    integer z
+ *
+ * @return     Morton key
+ */
+template <class T>
+uint64_t HashedOctree<T>::encode(uint32_t ix, uint32_t iy, uint32_t iz) {
+    auto spread = [](uint64_t v) {
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x1f00000000ffffull;
+        v = (v | v << 16) & 0x1f0000ff0000ffull;
+        v = (v | v << 8)  & 0x100f00f00f00f00full;
+        v = (v | v << 4)  & 0x10c30c30c30c30c3ull;
+        v = (v | v << 2)  & 0x1249249249249249ull;
+        return v;
+    };
+
+    return (spread(ix) << 2) | (spread(iz) << 1) | spread(iy);
+}
+
+/**
+ * @brief      extract integer coordinates from a Morton key
+ *
+ * @param[in]  m     Morton key
+ * @param[out] ix    integer x
+ * @param[out] iy    integer y
+ * @param[out] iz    integer z
+ */
+template <class T>
+void HashedOctree<T>::decode(uint64_t m, uint32_t* ix, uint32_t* iy, uint32_t* iz) {
+    auto compact = [](uint64_t v) {
+        v &= 0x1249249249249249ull;
+        v = (v ^ (v >> 2))  & 0x10c30c30c30c30c3ull;
+        v = (v ^ (v >> 4))  & 0x100f00f00f00f00full;
+        v = (v ^ (v >> 8))  & 0x1f0000ff0000ffull;
+        v = (v ^ (v >> 16)) & 0x1f00000000ffffull;
+        v = (v ^ (v >> 32)) & 0x1fffff;
+        return (uint32_t)v;
+    };
+
+    *ix = compact(m >> 2);
+    *iz = compact(m >> 1);
+    *iy = compact(m);
+}
+
+#endif // _HASHEDOCTREE_IMPL
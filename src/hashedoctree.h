@@ -0,0 +1,314 @@
+ /***********************************************************************************
+ #   This file is part of octree.                                                   #
+ #                                                                                  #
+ #   MIT License                                                                    #
+ #                                                                                  #
+ #   Copyright (c) 2018 Ivo Filot <ivo@ivofilot.nl>                                 #
+ #                                                                                  #
+ #   Permission is hereby granted, free of charge, to any person obtaining a copy   #
+ #   of this software and associated documentation files (the "Software"), to deal  #
+ #   in the Software without restriction, including without limitation the rights   #
+ #   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell      #
+ #   copies of the Software, and to permit persons to whom the Software is          #
+ #   furnished to do so, subject to the following conditions:                       #
+ #                                                                                  #
+ #   The above copyright notice and this permission notice shall be included in all #
+ #   copies or substantial portions of the Software.                                #
+ #                                                                                  #
+ #   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR     #
+ #   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,       #
+ #   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE    #
+ #   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER         #
+ #   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  #
+ #   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  #
+ #   SOFTWARE.                                                                      #
+ #                                                                                  #
+ #***********************************************************************************/
+
+
+#ifndef _HASHEDOCTREE_H
+#define _HASHEDOCTREE_H
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <algorithm>
+
+#include "octreetypes.h"
+
+/*
+ * Linear octree whose nodes live in an open-addressing hash table keyed by
+ * a locational code: the Morton key of the node prefixed by a sentinel bit,
+ * i.e. key = (1 << 3 * level) | morton. The octant bits of the Morton key
+ * follow the OT_* labels, so the key of child o of node k is (k << 3) | o.
+ *
+ * Any node can be looked up in O(1), the leaf containing a point is found
+ * by a binary search over the levels and neighbors are found by adding an
+ * offset to the integer coordinates encoded in the key.
+ */
+
+/**
+ * @brief      Class for hashed octree node.
+ *
+ * @tparam     T     object class
+ */
+template <class T>
+class HashedOctreeNode {
+
+private:
+    uint64_t key;               //!< locational code of the node
+    bool leaf = true;           //!< whether node is a leaf
+
+    std::vector<T*> objects;    //!< vector of pointers to objects
+    std::vector<double> pos;    //!< positions of the objects
+
+public:
+    /**
+     * @brief      Constructs the object.
+     *
+     * @param[in]  _key  locational code of the node
+     */
+    HashedOctreeNode(uint64_t _key) : key(_key) {}
+
+    /**
+     * @brief      get the locational code
+     *
+     * @return     key of the node
+     */
+    inline uint64_t get_key() const {
+        return this->key;
+    }
+
+    /**
+     * @brief      determines if node is leaf
+     *
+     * @return     True if leaf, False otherwise.
+     */
+    inline bool is_leaf() const {
+        return this->leaf;
+    }
+
+    /**
+     * @brief      get the objects of the node
+     *
+     * @return     vector of pointer to objects
+     */
+    inline const std::vector<T*>& get_objects() const {
+        return this->objects;
+    }
+
+    template <class U> friend class HashedOctree;
+};
+
+/**
+ * @brief      Class for hashed linear octree.
+ *
+ * @tparam     T     object type
+ */
+template <class T>
+class HashedOctree {
+
+public:
+    static const unsigned int max_level = 21;   //!< deepest level that fits in a 64 bit key
+
+private:
+    /**
+     * @brief      slot of the hash table
+     */
+    struct Slot {
+        uint64_t key = 0;                       //!< locational code (0 for an empty slot)
+        HashedOctreeNode<T>* node = nullptr;    //!< pointer to node
+    };
+
+    std::deque<HashedOctreeNode<T>> nodes;  //!< node storage (stable addresses)
+    std::vector<Slot> slots;                //!< open addressing table (power of two size)
+    unsigned int shift;                     //!< 64 - log2 of the number of slots
+    unsigned int depth = 0;                 //!< deepest level in the tree
+
+    double ox;                      //!< octree origin x
+    double oy;                      //!< octree origin y
+    double oz;                      //!< octree origin z
+
+    double x;                       //!< octree width
+    double y;                       //!< octree breadth
+    double z;                       //!< octree height
+
+public:
+    /**
+     * @brief      Hashed octree constructor
+     *
+     * @param[in]  _x    width of principal cell
+     * @param[in]  _y    breadth of principal cell
+     * @param[in]  _z    height of principal cell
+     */
+    HashedOctree(double _x, double _y, double _z);
+
+    /**
+     * @brief      add object to the tree
+     *
+     * @param      object  pointer to object
+     * @param[in]  _px     x position
+     * @param[in]  _py     y position
+     * @param[in]  _pz     z position
+     */
+    void add(T* object, double _px, double _py, double _pz);
+
+    /**
+     * @brief      find the leaf containing a position
+     *
+     * Performs a binary search over the levels, which is possible because
+     * all ancestors of a node are present in the table.
+     *
+     * @param[in]  _px   x position
+     * @param[in]  _py   y position
+     * @param[in]  _pz   z position
+     *
+     * @return     pointer to node
+     */
+    HashedOctreeNode<T>* find_node(double _px, double _py, double _pz) const;
+
+    /**
+     * @brief      get node given its locational code
+     *
+     * @param[in]  key   locational code
+     *
+     * @return     pointer to node or nullptr if not present
+     */
+    HashedOctreeNode<T>* get_node(uint64_t key) const;
+
+    /**
+     * @brief      find neighbor (equal or larger in size) in direction i
+     *
+     * @param[in]  node  pointer to node
+     * @param[in]  i     direction i (OT_D_*)
+     *
+     * @return     pointer to neighbor or nullptr at the domain boundary
+     */
+    HashedOctreeNode<T>* find_gteq_neighbor(const HashedOctreeNode<T>* node, unsigned int i) const;
+
+    /**
+     * @brief      find neighbors
+     *
+     * @param[in]  node  pointer to node
+     *
+     * @return     vector holding pointers to neighbor nodes
+     */
+    std::vector<HashedOctreeNode<T>*> find_neighbors(const HashedOctreeNode<T>* node) const;
+
+    /**
+     * @brief      get the center of a node
+     *
+     * @param[in]  node  pointer to node
+     * @param[out] _cx   center x
+     * @param[out] _cy   center y
+     * @param[out] _cz   center z
+     */
+    void get_center(const HashedOctreeNode<T>* node, double* _cx, double* _cy, double* _cz) const;
+
+    /**
+     * @brief      get the number of nodes in the tree
+     *
+     * @return     number of nodes
+     */
+    inline size_t size() const {
+        return this->nodes.size();
+    }
+
+    /**
+     * @brief      get the deepest level in the tree
+     *
+     * @return     level
+     */
+    inline unsigned int get_depth() const {
+        return this->depth;
+    }
+
+    /**
+     * @brief      get the level of a locational code
+     *
+     * @param[in]  key   locational code
+     *
+     * @return     level
+     */
+    static unsigned int key_level(uint64_t key);
+
+private:
+    /**
+     * @brief      split a leaf into 8 octants
+     *
+     * @param      node  pointer to node
+     */
+    void split(HashedOctreeNode<T>* node);
+
+    /**
+     * @brief      insert a new node in the table
+     *
+     * @param[in]  key   locational code
+     *
+     * @return     pointer to the new node
+     */
+    HashedOctreeNode<T>* insert(uint64_t key);
+
+    /**
+     * @brief      double the size of the table and rehash all nodes
+     */
+    void grow();
+
+    /**
+     * @brief      get the key at the deepest level for a position
+     *
+     * @param[in]  _px   x position
+     * @param[in]  _py   y position
+     * @param[in]  _pz   z position
+     *
+     * @return     Morton key (without sentinel bit) at max_level
+     */
+    uint64_t point_key(double _px, double _py, double _pz) const;
+
+    /**
+     * @brief      convert coordinate to integer grid at max_level
+     *
+     * @param[in]  p     position
+     * @param[in]  o     origin
+     * @param[in]  l     length of the domain
+     *
+     * @return     integer coordinate
+     */
+    static uint32_t grid(double p, double o, double l);
+
+    /**
+     * @brief      interleave integer coordinates into a Morton key
+     *
+     * @param[in]  ix    integer x
+     * @param[in]  iy    integer y
+     * @param[in]  iz    integer z
+     *
+     * @return     Morton key
+     */
+    static uint64_t encode(uint32_t ix, uint32_t iy, uint32_t iz);
+
+    /**
+     * @brief      extract integer coordinates from a Morton key
+     *
+     * @param[in]  m     Morton key
+     * @param[out] ix    integer x
+     * @param[out] iy    integer y
+     * @param[out] iz    integer z
+     */
+    static void decode(uint64_t m, uint32_t* ix, uint32_t* iy, uint32_t* iz);
+
+    /**
+     * @brief      hash a locational code onto a slot
+     *
+     * @param[in]  key   locational code
+     *
+     * @return     slot index
+     */
+    inline size_t hash(uint64_t key) const {
+        return (size_t)((key * 0x9E3779B97F4A7C15ull) >> this->shift);
+    }
+};
+
+#include "hashedoctree.cpp"
+
+#endif // _HASHEDOCTREE_H
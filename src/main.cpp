@@ -26,14 +26,58 @@
  #***********************************************************************************/
 
 #include <string>
+#include <vector>
 #include <random>
+#include <memory>
+#include <iostream>
 #include <boost/lexical_cast.hpp>
 
 #include "octree.h"
+#include "hashedoctree.h"
+#include "snapshotoctree.h"
+#include "pointcloud.h"
 
 template class Octree<std::string>;
+template class Octree<size_t>;
+template class Octree<size_t, 2>;
+template class HashedOctree<size_t>;
+template class SnapshotOctree<size_t>;
+template class OctreeSnapshot<size_t>;
+
+int main(int argc, char* argv[]) {
+    if(argc > 1) {
+        std::unique_ptr<PointCloud> cloud_ptr;
+        try {
+            cloud_ptr = std::make_unique<PointCloud>(argv[1]);
+        } catch(const std::exception& e) {
+            std::cerr << "Error reading " << argv[1] << ": " << e.what() << std::endl;
+            return 1;
+        }
+        PointCloud& cloud = *cloud_ptr;
+
+        double bmin[3], bmax[3];
+        cloud.get_bounds(bmin, bmax);
+
+        // cubic principal cell slightly larger than the point cloud
+        const double l = std::max(bmax[0] - bmin[0], std::max(bmax[1] - bmin[1], bmax[2] - bmin[2])) * 1.001 + 1e-9;
+        Octree<size_t> octree((bmin[0] + bmax[0]) / 2.0, (bmin[1] + bmax[1]) / 2.0, (bmin[2] + bmax[2]) / 2.0, l, l, l);
+        std::vector<size_t*> handles(cloud.size());
+        for(size_t i=0; i<cloud.size(); i++) {
+            handles[i] = cloud.get_indices() + i;
+        }
+        octree.add_many(handles.data(), cloud.get_positions(), cloud.size());
+
+        size_t nleaves = 0;
+        for(auto& leaf : octree.leaves()) {
+            (void)leaf;
+            nleaves++;
+        }
+
+        std::cout << "Read " << cloud.size() << " points into " << nleaves << " leaves" << std::endl;
+
+        return 0;
+    }
 
-int main() {
     Octree<std::string> octree(10, 10, 10);
 
     std::uniform_real_distribution<double> unif(0.0, 10.0);
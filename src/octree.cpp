@@ -46,8 +46,8 @@
  * @param[in]  _pz     height of principal cell
  *
  */
-template <class T>
-Octree<T>::Octree(double _x, double _y, double _z) :
+template <class T, unsigned int D>
+Octree<T, D>::Octree(double _x, double _y, double _z) :
     cx(_x/2),
     cy(_y/2),
     cz(_z/2),
@@ -55,12 +55,45 @@ Octree<T>::Octree(double _x, double _y, double _z) :
     y(_y),
     z(_z) {
 
-    this->root = new OctreeNode<T>(nullptr,
+    this->root = new OctreeNode<T, D>(nullptr,
                                    this->cx, this->cy, this->cz,
                                    this->x, this->y, this->z,
                                    0);
 }
 
+/**
+ * @brief      Octree constructor
+ *
+ * @param[in]  _cx    center x of principal cell
+ * @param[in]  _cy    center y of principal cell
+ * @param[in]  _cz    center z of principal cell
+ * @param[in]  _x     width of principal cell
+ * @param[in]  _y     breadth of principal cell
+ * @param[in]  _z     height of principal cell
+ */
+template <class T, unsigned int D>
+Octree<T, D>::Octree(double _cx, double _cy, double _cz, double _x, double _y, double _z) :
+    cx(_cx),
+    cy(_cy),
+    cz(_cz),
+    x(_x),
+    y(_y),
+    z(_z) {
+
+    this->root = new OctreeNode<T, D>(nullptr,
+                                   this->cx, this->cy, this->cz,
+                                   this->x, this->y, this->z,
+                                   0);
+}
+
+/**
+ * @brief      Octree destructor
+ */
+template <class T, unsigned int D>
+Octree<T, D>::~Octree() {
+    OctreeNode<T, D>::destroy(this->root);
+}
+
 /**
  * @brief      add object to the tree
  *
@@ -70,297 +103,2008 @@ Octree<T>::Octree(double _x, double _y, double _z) :
  * @param[in]  _pz     z position
  *
  */
-template <class T>
-void Octree<T>::add(T* object, double _px, double _py, double _pz) {
-    this->root->find_node(_px, _py, _pz)->add(object, _px, _py, _pz);
+template <class T, unsigned int D>
+void Octree<T, D>::add(T* object, double _px, double _py, double _pz) {
+    this->root->find_node(_px, _py, _pz)->add(object, _px, _py, _pz, this->loose);
+}
+
+/**
+ * @brief      add an array of objects to the tree
+ *
+ * The batch is partitioned in place by octant at every node and large
+ * partitions are inserted in parallel. A leaf receiving more objects
+ * than it can hold is split once per level, down to the maximum level.
+ *
+ * @param      objects  pointers to the objects
+ * @param[in]  xyz      positions (x, y and z for every object)
+ * @param[in]  n        number of objects
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::add_many(T* const* objects, const double* xyz, size_t n) {
+    std::vector<Entry> entries(n);
+
+    #pragma omp parallel for
+    for(size_t i=0; i<n; i++) {
+        entries[i] = {{xyz[i*3], xyz[i*3+1], xyz[i*3+2]}, objects[i]};
+    }
+
+    #pragma omp parallel
+    #pragma omp single
+    this->add_range(this->root, entries.data(), entries.data() + n);
+}
+
+/**
+ * @brief      add object with a bounding box to the tree
+ *
+ * The object is stored at the deepest node whose loose box contains
+ * its bounding box; this may be an internal node. Such objects are
+ * found with find_overlapping and for_each_overlapping_pair.
+ *
+ * @param      object  pointer to object
+ * @param[in]  _bmin   lower corner of the bounding box
+ * @param[in]  _bmax   upper corner of the bounding box
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::add(T* object, const double _bmin[3], const double _bmax[3]) {
+    this->add_box(this->root, object, _bmin, _bmax);
+}
+
+/**
+ * @brief      set the looseness factor of the cells
+ *
+ * The loose box of a cell shares its center with the cell and is
+ * larger by this factor (2 by default). Objects with a bounding box
+ * that are already in the tree are redistributed.
+ *
+ * @param[in]  k     looseness factor (at least 1)
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::set_looseness(double k) {
+    std::vector<T*> boxed;
+    std::vector<double> boxes;
+
+    for(auto& node : this->nodes()) {
+        boxed.insert(boxed.end(), node.boxed.begin(), node.boxed.end());
+        boxes.insert(boxes.end(), node.boxes.begin(), node.boxes.end());
+        node.boxed.clear();
+        node.boxes.clear();
+    }
+    this->loose = std::max(k, 1.0);
+    this->update_bounds();
+
+    for(unsigned int i=0; i<boxed.size(); i++) {
+        this->add(boxed[i], &boxes[i*6], &boxes[i*6+3]);
+    }
+}
+
+/**
+ * @brief      move all objects of another tree into this tree
+ *
+ * Both trees are walked together. Subtrees present in only one tree
+ * are moved over without copying; where a leaf meets a leaf or a
+ * subtree, the objects of the leaf are added to the other side. The
+ * other tree is left empty.
+ *
+ * The positions of the other tree are stored with the precision of this
+ * tree; the error bound of the result is the larger of the two bounds.
+ *
+ * @param      other  tree with the same principal cell
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::merge(Octree<T, D>&& other) {
+    if(&other == this) {
+        return;
+    }
+
+    if(this->cx != other.cx || this->cy != other.cy || this->cz != other.cz ||
+       this->x != other.x || this->y != other.y || this->z != other.z) {
+        throw std::runtime_error("Cannot merge octrees with different principal cells");
+    }
+
+    // moved nodes keep their storage, so bring the other tree in line first
+    if(other.loose != this->loose) {
+        other.set_looseness(this->loose);
+    }
+    if(other.root->qbits != this->root->qbits) {
+        for(auto& node : other.nodes()) {
+            node.set_qbits(this->root->qbits);
+        }
+    }
+
+    OctreeNode<T, D>* b = other.root;
+    this->merge_nodes(this->root, b);
+
+    other.root = new OctreeNode<T, D>(nullptr,
+                                   other.cx, other.cy, other.cz,
+                                   other.x, other.y, other.z,
+                                   0);
+    other.root->qbits = b->qbits;
+    OctreeNode<T, D>::destroy(b);
+
+    this->qerror = std::max(this->qerror, other.qerror);
+    other.qerror = 0.0;
+
+    // moved nodes and storage may live in the arenas of the other tree
+    for(auto& arena : other.arenas) {
+        this->arenas.push_back(std::move(arena));
+    }
+    other.arenas.clear();
+
+    this->update_bounds();
+}
+
+/**
+ * @brief      relocate all nodes and their storage into one buffer
+ *
+ * The nodes are placed in breadth-first order (OT_LAYOUT_BFS), in
+ * depth-first Morton order (OT_LAYOUT_DFS) or in van Emde Boas order
+ * (OT_LAYOUT_VEB), followed by the positions and bounding boxes of the
+ * objects in the same order. The storage is sized exactly. The object
+ * pointers and objects added afterwards are stored on the heap.
+ *
+ * @param[in]  layout  order of the nodes
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::compact(unsigned int layout) {
+    std::vector<OctreeNode<T, D>*> order;
+
+    if(layout == OT_LAYOUT_BFS) {
+        order.push_back(this->root);
+        for(size_t i=0; i<order.size(); i++) {
+            if(!order[i]->leaf) {
+                order.insert(order.end(), order[i]->children, order[i]->children + nr_children);
+            }
+        }
+    } else if(layout == OT_LAYOUT_VEB) {
+        unsigned int height = 0;
+        for(auto& node : this->leaves()) {
+            height = std::max(height, node.level + 1);
+        }
+        this->veb_order(this->root, height, order);
+    } else {
+        for(auto& node : this->nodes()) {
+            order.push_back(&node);
+        }
+    }
+
+    size_t size = order.size() * sizeof(OctreeNode<T, D>);
+    for(const OctreeNode<T, D>* node : order) {
+        size += node->storage_size();
+    }
+
+    std::unique_ptr<OctreeArena> arena(new OctreeArena(size));
+    OctreeNode<T, D>* pool = static_cast<OctreeNode<T, D>*>(arena->take(order.size() * sizeof(OctreeNode<T, D>)));
+
+    std::unordered_map<const OctreeNode<T, D>*, OctreeNode<T, D>*> moved;
+    for(size_t i=0; i<order.size(); i++) {
+        new (&pool[i]) OctreeNode<T, D>(*order[i], arena.get());
+        moved.emplace(order[i], &pool[i]);
+    }
+    arena->close();
+
+    for(size_t i=0; i<order.size(); i++) {
+        const OctreeNode<T, D>* node = order[i];
+        pool[i].parent = node->parent == nullptr ? nullptr : moved.find(node->parent)->second;
+        if(!node->leaf) {
+            for(unsigned int o=0; o<nr_children; o++) {
+                pool[i].children[o] = moved.find(node->children[o])->second;
+            }
+        }
+    }
+
+    // the old nodes may live in the old arenas
+    OctreeNode<T, D>::destroy(this->root);
+    this->root = moved.find(this->root)->second;
+    this->arenas.clear();
+    this->arenas.push_back(std::move(arena));
+}
+
+/**
+ * @brief      store positions as fixed-point offsets inside the leaf cells
+ *
+ * The positions are stored with 16 bits per coordinate if that satisfies
+ * the tolerance, else with 21 bits, else with full precision. Because cells
+ * only shrink upon splitting, the error bound holds for the lifetime of
+ * the tree.
+ *
+ * The error of positions that have been stored lossily is kept when
+ * switching to a finer precision; the grids of the cells are nested, such
+ * that the returned bound is the largest bound applied so far.
+ *
+ * @param[in]  tolerance  maximum error per coordinate (0 for full precision)
+ *
+ * @return     guaranteed error bound per coordinate (0 if no position
+ *             has been stored lossily)
+ */
+template <class T, unsigned int D>
+double Octree<T, D>::set_position_compression(double tolerance) {
+    const double l = std::max(this->x, std::max(this->y, this->z));
+
+    unsigned int bits = 0;
+    if(tolerance > 0.0 && l / (double)(1u << 16) <= tolerance) {
+        bits = 16;
+    } else if(tolerance > 0.0 && l / (double)(1u << 21) <= tolerance) {
+        bits = 21;
+    }
+
+    for(auto& node : this->nodes()) {
+        node.set_qbits(bits);
+    }
+    this->update_bounds();
+
+    if(bits != 0) {
+        this->qerror = std::max(this->qerror, l / (double)(1u << bits));
+    }
+
+    return this->qerror;
+}
+
+/**
+ * @brief      find all objects within a distance from a position
+ *
+ * @param[in]  _px   x position
+ * @param[in]  _py   y position
+ * @param[in]  _pz   z position
+ * @param[in]  r     radius
+ *
+ * @return     vector of pointers to objects
+ */
+template <class T, unsigned int D>
+std::vector<T*> Octree<T, D>::find_within_radius(double _px, double _py, double _pz, double r) const {
+    std::vector<T*> result;
+    std::vector<const OctreeNode<T, D>*> stack(1, this->root);
+    const double r2 = r * r;
+
+    while(!stack.empty()) {
+        const OctreeNode<T, D>* node = stack.back();
+        stack.pop_back();
+
+        if(node->bounds_distance2(_px, _py, _pz) > r2) {
+            continue;
+        }
+
+        if(!node->is_leaf()) {
+            for(unsigned int o=0; o<nr_children; o++) {
+                stack.push_back(node->get_child(o));
+            }
+            continue;
+        }
+
+        double qx, qy, qz;
+        for(unsigned int i=0; i<node->get_objects().size(); i++) {
+            node->get_position(i, &qx, &qy, &qz);
+            if((qx - _px) * (qx - _px) + (qy - _py) * (qy - _py) + (qz - _pz) * (qz - _pz) <= r2) {
+                result.push_back(node->get_objects()[i]);
+            }
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief      find the leaves for a batch of positions
+ *
+ * Interleaves a group of independent descents: every lane advances a
+ * single level, prefetches its next node and yields to the next lane, so
+ * that the cache misses of the lanes overlap instead of being serialized.
+ *
+ * @param[in]  xyz    positions (x, y and z for every position)
+ * @param[in]  n      number of positions
+ * @param[out] out    pointers to the leaves
+ * @param[in]  group  number of lookups in flight
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::find_nodes(const double* xyz, size_t n, OctreeNode<T, D>** out, unsigned int group) const {
+    group = std::max(group, 1u);
+    std::vector<const OctreeNode<T, D>*> node(group, nullptr);
+    std::vector<size_t> query(group, 0);
+    size_t next = 0;
+    unsigned int active = 0;
+
+    // fill the lanes
+    for(unsigned int l=0; l<group && next<n; l++, next++, active++) {
+        node[l] = this->root;
+        query[l] = next;
+    }
+
+    while(active > 0) {
+        for(unsigned int l=0; l<group; l++) {
+            const OctreeNode<T, D>* q = node[l];
+            if(q == nullptr) {
+                continue;
+            }
+
+            const double* p = &xyz[query[l] * 3];
+            if(!q->is_leaf()) {
+                node[l] = q->get_child(q->get_octant(p[0], p[1], p[2]));
+                node[l]->prefetch();
+                continue;
+            }
+
+            // lookup finished; start the next one in this lane
+            out[query[l]] = const_cast<OctreeNode<T, D>*>(q);
+            if(next < n) {
+                node[l] = this->root;
+                query[l] = next++;
+            } else {
+                node[l] = nullptr;
+                active--;
+            }
+        }
+    }
+}
+
+/**
+ * @brief      find neighbors (equal or larger in size) in direction i for
+ *             a batch of nodes
+ *
+ * Runs the algorithm of find_gteq_neighbor without recursion for a group
+ * of interleaved lanes: each lane first ascends while the node lies on the
+ * side of its parent along any axis of the direction, remembering the
+ * directions and octant types, and then descends along the reflected
+ * octants. Every step prefetches the next node.
+ *
+ * @param[in]  nodes  nodes
+ * @param[in]  n      number of nodes
+ * @param[in]  i      direction i (face, edge or vertex direction)
+ * @param[out] out    pointers to the neighbors
+ * @param[in]  group  number of lookups in flight
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::find_gteq_neighbors(OctreeNode<T, D>* const* nodes, size_t n, unsigned int i, OctreeNode<T, D>** out, unsigned int group) const {
+    struct Lane {
+        const OctreeNode<T, D>* node = nullptr;    // current node
+        size_t query = 0;                       // index of the lookup
+        unsigned int dir = 0;                   // direction at the current node
+        bool ascending = false;                 // phase of the lookup
+        std::vector<std::pair<unsigned char, unsigned char>> steps;    // directions and octant types on the way up
+    };
+
+    std::vector<Lane> lanes(std::max(group, 1u));
+    size_t next = 0;
+    unsigned int active = 0;
+
+    auto start = [&](Lane& lane) {
+        lane.node = nodes[next];
+        lane.query = next++;
+        lane.dir = i;
+        lane.ascending = true;
+        lane.steps.clear();
+        active++;
+    };
+
+    for(unsigned int l=0; l<lanes.size() && next<n; l++) {
+        start(lanes[l]);
+    }
+
+    while(active > 0) {
+        for(Lane& lane : lanes) {
+            if(lane.node == nullptr && !lane.ascending) {
+                continue;
+            }
+
+            if(lane.ascending) {
+                const OctreeNode<T, D>* q = lane.node;
+                lane.node = q->get_parent();
+                lane.ascending = false;
+
+                // the root has no octant type; its neighbor lies outside
+                // the principal cell
+                if(lane.node != nullptr) {
+                    const unsigned int type = q->get_type();
+                    const unsigned int c = q->common(lane.dir, type);
+                    lane.steps.emplace_back(lane.dir, type);
+                    if(c != OctreeNode<T, D>::nr_directions) {
+                        lane.ascending = true;
+                        lane.dir = c;
+                    }
+                    lane.node->prefetch();
+                    continue;
+                }
+            } else if(!lane.steps.empty() && !lane.node->is_leaf()) {
+                lane.node = lane.node->get_child(lane.node->reflect(lane.steps.back().first, lane.steps.back().second));
+                lane.steps.pop_back();
+                lane.node->prefetch();
+                continue;
+            }
+
+            // lookup finished; start the next one in this lane
+            out[lane.query] = const_cast<OctreeNode<T, D>*>(lane.node);
+            lane.node = nullptr;
+            lane.ascending = false;
+            active--;
+            if(next < n) {
+                start(lane);
+            }
+        }
+    }
+}
+
+/**
+ * @brief      find the k objects nearest to a position
+ *
+ * Nodes are visited in order of increasing distance to the bounding box of
+ * their contents until that distance exceeds the k-th nearest object found.
+ *
+ * @param[in]  _px   x position
+ * @param[in]  _py   y position
+ * @param[in]  _pz   z position
+ * @param[in]  k     number of objects
+ *
+ * @return     vector of pointers to objects, nearest first
+ */
+template <class T, unsigned int D>
+std::vector<T*> Octree<T, D>::find_nearest(double _px, double _py, double _pz, unsigned int k) const {
+    typedef std::pair<double, const OctreeNode<T, D>*> NodeItem;
+    typedef std::pair<double, T*> ObjectItem;
+
+    std::priority_queue<NodeItem, std::vector<NodeItem>, std::greater<NodeItem>> queue;
+    std::priority_queue<ObjectItem> best;   // max-heap holding the k nearest objects
+
+    if(k == 0) {
+        return std::vector<T*>();
+    }
+
+    queue.emplace(this->root->bounds_distance2(_px, _py, _pz), this->root);
+    while(!queue.empty()) {
+        const double d2 = queue.top().first;
+        const OctreeNode<T, D>* node = queue.top().second;
+        queue.pop();
+
+        if(d2 == std::numeric_limits<double>::infinity() || (best.size() == k && d2 > best.top().first)) {
+            break;
+        }
+
+        if(!node->is_leaf()) {
+            for(unsigned int o=0; o<nr_children; o++) {
+                const OctreeNode<T, D>* child = node->get_child(o);
+                queue.emplace(child->bounds_distance2(_px, _py, _pz), child);
+            }
+            continue;
+        }
+
+        double qx, qy, qz;
+        for(unsigned int i=0; i<node->get_objects().size(); i++) {
+            node->get_position(i, &qx, &qy, &qz);
+            const double o2 = (qx - _px) * (qx - _px) + (qy - _py) * (qy - _py) + (qz - _pz) * (qz - _pz);
+            if(best.size() < k) {
+                best.emplace(o2, node->get_objects()[i]);
+            } else if(o2 < best.top().first) {
+                best.pop();
+                best.emplace(o2, node->get_objects()[i]);
+            }
+        }
+    }
+
+    std::vector<T*> result(best.size());
+    for(size_t i=result.size(); i>0; i--) {
+        result[i-1] = best.top().second;
+        best.pop();
+    }
+
+    return result;
+}
+
+/**
+ * @brief      call a function for every pair of objects within a distance
+ *
+ * Traverses pairs of nodes simultaneously, discarding a pair as soon as
+ * the bounding boxes of their contents are further apart than r. Every
+ * unordered pair of objects is reported once.
+ *
+ * @param[in]  r     distance
+ * @param[in]  fn    function receiving both objects of the pair
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::for_each_pair_within(double r, const std::function<void(T*, T*)>& fn) const {
+    typedef std::pair<const OctreeNode<T, D>*, const OctreeNode<T, D>*> NodePair;
+
+    const double r2 = r * r;
+    std::vector<NodePair> stack(1, NodePair(this->root, this->root));
+
+    while(!stack.empty()) {
+        const OctreeNode<T, D>* a = stack.back().first;
+        const OctreeNode<T, D>* b = stack.back().second;
+        stack.pop_back();
+
+        if(a->bounds_distance2(b) > r2) {
+            continue;
+        }
+
+        if(a == b && !a->is_leaf()) {
+            for(unsigned int i=0; i<nr_children; i++) {
+                for(unsigned int j=i; j<nr_children; j++) {
+                    stack.emplace_back(a->get_child(i), a->get_child(j));
+                }
+            }
+            continue;
+        }
+
+        // descend into the coarser of the two internal nodes
+        if(!a->is_leaf() && (b->is_leaf() || a->get_level() <= b->get_level())) {
+            for(unsigned int i=0; i<nr_children; i++) {
+                stack.emplace_back(a->get_child(i), b);
+            }
+            continue;
+        }
+        if(!b->is_leaf()) {
+            for(unsigned int j=0; j<nr_children; j++) {
+                stack.emplace_back(a, b->get_child(j));
+            }
+            continue;
+        }
+
+        double p[3], q[3];
+        for(unsigned int i=0; i<a->get_objects().size(); i++) {
+            a->get_position(i, &p[0], &p[1], &p[2]);
+            for(unsigned int j=(a == b ? i + 1 : 0); j<b->get_objects().size(); j++) {
+                b->get_position(j, &q[0], &q[1], &q[2]);
+                if((p[0] - q[0]) * (p[0] - q[0]) + (p[1] - q[1]) * (p[1] - q[1]) + (p[2] - q[2]) * (p[2] - q[2]) <= r2) {
+                    fn(a->get_objects()[i], b->get_objects()[j]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief      find all objects overlapping a box
+ *
+ * Objects with a position count as boxes of zero size.
+ *
+ * @param[in]  _bmin  lower corner of the box
+ * @param[in]  _bmax  upper corner of the box
+ *
+ * @return     vector of pointers to objects
+ */
+template <class T, unsigned int D>
+std::vector<T*> Octree<T, D>::find_overlapping(const double _bmin[3], const double _bmax[3]) const {
+    std::vector<T*> result;
+    this->for_each_overlapping(this->root, _bmin, _bmax, [&result](T* object) {
+        result.push_back(object);
+    });
+
+    return result;
+}
+
+/**
+ * @brief      call a function for every pair of objects with
+ *             overlapping boxes
+ *
+ * Objects with a position count as boxes of zero size. The pairs are
+ * processed in parallel, such that the function may be called
+ * concurrently.
+ *
+ * @param[in]  fn    function receiving both objects of the pair
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::for_each_overlapping_pair(const std::function<void(T*, T*)>& fn) const {
+    typedef std::pair<const OctreeNode<T, D>*, const OctreeNode<T, D>*> NodePair;
+
+    // expand the node pairs breadth-first until there is enough work to
+    // spread over the threads
+    std::vector<NodePair> pairs(1, NodePair(this->root, this->root));
+    while(!pairs.empty() && pairs.size() < 1024) {
+        std::vector<NodePair> next;
+        for(const NodePair& p : pairs) {
+            this->overlap_step(p.first, p.second, next, fn);
+        }
+        pairs.swap(next);
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int i=0; i<(int)pairs.size(); i++) {
+        std::vector<NodePair> stack(1, pairs[i]);
+        while(!stack.empty()) {
+            const NodePair p = stack.back();
+            stack.pop_back();
+            this->overlap_step(p.first, p.second, stack, fn);
+        }
+    }
+}
+
+/**
+ * @brief      recalculate the bounding boxes of the contents of all nodes
+ *
+ * The boxes are maintained upon adding objects; this function is meant
+ * to restore them after bulk changes.
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::update_bounds() {
+    for(auto& node : this->nodes(OT_ORDER_POST)) {
+        node.update_bounds();
+    }
+}
+
+/**
+ * @brief      refine the tree until it satisfies the 2:1 balance condition
+ *
+ * @return     nodes that have been split
+ */
+template <class T, unsigned int D>
+std::vector<OctreeNode<T, D>*> Octree<T, D>::balance() {
+    std::vector<OctreeNode<T, D>*> seeds;
+    for(auto& leaf : this->leaves()) {
+        seeds.push_back(&leaf);
+    }
+
+    return this->balance_leaves(seeds);
+}
+
+/**
+ * @brief      restore the 2:1 balance condition around changed nodes
+ *
+ * @param[in]  changed  nodes that have been split since the tree was
+ *                      last balanced
+ *
+ * @return     nodes that have been split
+ */
+template <class T, unsigned int D>
+std::vector<OctreeNode<T, D>*> Octree<T, D>::balance(const std::vector<OctreeNode<T, D>*>& changed) {
+    std::vector<OctreeNode<T, D>*> seeds;
+    for(OctreeNode<T, D>* node : changed) {
+        for(auto& leaf : OctreeRange<T, D>(node, OT_ORDER_PRE, true, -1)) {
+            seeds.push_back(&leaf);
+        }
+    }
+
+    return this->balance_leaves(seeds);
+}
+
+/**
+ * @brief      split leaves for which a predicate holds
+ *
+ * The predicate is evaluated in parallel on all leaves, after which the
+ * selected leaves are split in parallel; this is repeated on the new
+ * leaves until the predicate no longer selects any of them.
+ *
+ * @param[in]  pred  predicate on a leaf (its box, level and contents)
+ *
+ * @return     nodes that have been split, including children that were
+ *             split because they received too many objects
+ */
+template <class T, unsigned int D>
+std::vector<OctreeNode<T, D>*> Octree<T, D>::refine(const std::function<bool(const OctreeNode<T, D>&)>& pred) {
+    std::vector<OctreeNode<T, D>*> changed;
+    std::vector<OctreeNode<T, D>*> work;
+    for(auto& leaf : this->leaves()) {
+        work.push_back(&leaf);
+    }
+
+    while(!work.empty()) {
+        const std::vector<OctreeNode<T, D>*> selected = this->select(work, pred);
+
+        // see split() on concurrent splits
+        #pragma omp parallel for schedule(dynamic, 16)
+        for(int i=0; i<(int)selected.size(); i++) {
+            selected[i]->split(this->loose);
+        }
+
+        // full children are split along with the selected leaves
+        work.clear();
+        for(OctreeNode<T, D>* node : selected) {
+            for(auto& sub : OctreeRange<T, D>(node, OT_ORDER_PRE, false, -1)) {
+                if(sub.leaf) {
+                    work.push_back(&sub);
+                } else {
+                    changed.push_back(&sub);
+                }
+            }
+        }
+    }
+
+    return changed;
+}
+
+/**
+ * @brief      merge the children of nodes for which a predicate holds
+ *
+ * Only nodes whose children are all leaves are considered. The predicate
+ * is evaluated in parallel, after which the selected nodes are merged in
+ * parallel; this is repeated on the parents of the merged nodes.
+ *
+ * @param[in]  pred  predicate on a node (its box, level and the contents
+ *                   of its children)
+ *
+ * @return     nodes that have been turned into leaves
+ */
+template <class T, unsigned int D>
+std::vector<OctreeNode<T, D>*> Octree<T, D>::coarsen(const std::function<bool(const OctreeNode<T, D>&)>& pred) {
+    std::vector<OctreeNode<T, D>*> changed;
+    std::vector<OctreeNode<T, D>*> work;
+    for(auto& leaf : this->leaves()) {
+        work.push_back(leaf.get_parent());
+    }
+
+    auto mergeable = [&pred](const OctreeNode<T, D>& node) {
+        for(unsigned int o=0; o<nr_children; o++) {
+            if(!node.get_child(o)->is_leaf()) {
+                return false;
+            }
+        }
+        return pred(node);
+    };
+
+    while(!work.empty()) {
+        std::sort(work.begin(), work.end());
+        work.erase(std::unique(work.begin(), work.end()), work.end());
+        if(work.front() == nullptr) {
+            work.erase(work.begin());
+        }
+
+        const std::vector<OctreeNode<T, D>*> selected = this->select(work, mergeable);
+
+        // merging only modifies the subtree of the merged node
+        #pragma omp parallel for schedule(dynamic, 16)
+        for(int i=0; i<(int)selected.size(); i++) {
+            selected[i]->merge();
+        }
+
+        work.clear();
+        for(OctreeNode<T, D>* node : selected) {
+            // merging may move quantized positions onto a coarser grid
+            OctreeNode<T, D>* parent = node->get_parent();
+            if(parent != nullptr && !node->is_empty()) {
+                parent->expand_bounds(node->get_bounds_min()[0], node->get_bounds_min()[1], node->get_bounds_min()[2]);
+                parent->expand_bounds(node->get_bounds_max()[0], node->get_bounds_max()[1], node->get_bounds_max()[2]);
+            }
+            work.push_back(parent);
+        }
+        changed.insert(changed.end(), selected.begin(), selected.end());
+    }
+
+    return changed;
+}
+
+/**
+ * @brief      partition the leaves into k chunks of balanced weight
+ *
+ * The leaves are cut in Morton order into contiguous chunks such that the
+ * accumulated weight of every chunk is as close as possible to 1/k of the
+ * total weight. For every chunk, the leaves of other chunks that share a
+ * face, edge or vertex with it are collected as its halo.
+ *
+ * @param[in]  k          number of chunks
+ * @param[in]  weight_fn  weight of a leaf (defaults to its number of objects)
+ *
+ * @return     vector of k partitions
+ */
+template <class T, unsigned int D>
+std::vector<OctreePartition<T, D>> Octree<T, D>::partition(unsigned int k, const std::function<double(const OctreeNode<T, D>&)>& weight_fn) {
+    std::vector<OctreePartition<T, D>> partitions;
+    if(k == 0) {
+        return partitions;
+    }
+
+    // collect the leaves and the prefix sum of their weights
+    std::vector<OctreeNode<T, D>*> leaves;
+    std::vector<double> prefix(1, 0.0);
+    for(auto& leaf : this->leaves()) {
+        leaves.push_back(&leaf);
+        prefix.push_back(prefix.back() + (weight_fn ? weight_fn(leaf) : (double)leaf.get_objects().size()));
+    }
+
+    // place each cut at the leaf boundary closest to its target weight
+    std::vector<size_t> cuts(k + 1, 0);
+    cuts[k] = leaves.size();
+    for(unsigned int j=1; j<k; j++) {
+        const double target = prefix.back() * j / k;
+        size_t c = std::lower_bound(prefix.begin(), prefix.end(), target) - prefix.begin();
+        if(c > 0 && target - prefix[c-1] < prefix[c] - target) {
+            c--;
+        }
+        cuts[j] = std::min(std::max(c, cuts[j-1]), leaves.size());
+    }
+
+    // construct the views on the leaves between the cuts
+    std::vector<OctreeIterator<T, D>> bounds;
+    auto range = this->leaves();
+    auto it = range.begin();
+    size_t idx = 0;
+    for(unsigned int j=0; j<=k; j++) {
+        while(idx < cuts[j]) {
+            ++it;
+            idx++;
+        }
+        bounds.push_back(it);
+    }
+
+    std::unordered_map<const OctreeNode<T, D>*, size_t> index;
+    index.reserve(leaves.size());
+    for(size_t i=0; i<leaves.size(); i++) {
+        index[leaves[i]] = i;
+    }
+
+    for(unsigned int j=0; j<k; j++) {
+        partitions.emplace_back(OctreeRange<T, D>(bounds[j], bounds[j+1]),
+                                cuts[j+1] - cuts[j],
+                                prefix[cuts[j+1]] - prefix[cuts[j]]);
+    }
+
+    // collect the halo of each chunk
+    #pragma omp parallel for schedule(dynamic)
+    for(int j=0; j<(int)k; j++) {
+        std::vector<size_t> halo;
+        std::vector<OctreeNode<T, D>*> stack;
+
+        for(size_t i=cuts[j]; i<cuts[j+1]; i++) {
+            const OctreeNode<T, D>* leaf = leaves[i];
+            for(OctreeNode<T, D>* q : leaf->find_neighbors()) {
+                // finer neighbors are found as an equally sized internal node
+                stack.push_back(q);
+                while(!stack.empty()) {
+                    OctreeNode<T, D>* n = stack.back();
+                    stack.pop_back();
+
+                    if(!n->is_leaf()) {
+                        for(unsigned int o=0; o<nr_children; o++) {
+                            if(leaf->touches(n->get_child(o))) {
+                                stack.push_back(n->get_child(o));
+                            }
+                        }
+                        continue;
+                    }
+
+                    const size_t h = index.find(n)->second;
+                    if(h < cuts[j] || h >= cuts[j+1]) {
+                        halo.push_back(h);
+                    }
+                }
+            }
+        }
+
+        std::sort(halo.begin(), halo.end());
+        halo.erase(std::unique(halo.begin(), halo.end()), halo.end());
+        for(size_t h : halo) {
+            partitions[j].halo.push_back(leaves[h]);
+        }
+    }
+
+    return partitions;
+}
+
+/**
+ * @brief      add a range of objects to a subtree
+ *
+ * @param      node   top of the subtree
+ * @param      first  first object
+ * @param      last   one past the last object
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::add_range(OctreeNode<T, D>* node, Entry* first, Entry* last) {
+    if(first == last) {
+        return;
+    }
+
+    if(node->leaf) {
+        if(node->count() + (last - first) < 16 || node->level >= OctreeNode<T, D>::max_level) {
+            for(Entry* e = first; e != last; e++) {
+                node->store(e->object, e->p[0], e->p[1], e->p[2]);
+            }
+            return;
+        }
+
+        // the leaf holds fewer than 16 objects, such that its children
+        // are not split any further by the migration
+        node->split(this->loose);
+    }
+
+    // partition by x, then z, then y (x, then y in 2-D); this yields the
+    // children in order
+    const double c[3] = {node->cx, D == 3 ? node->cz : node->cy, node->cy};
+    const unsigned int axis[3] = {0, D == 3 ? 2u : 1u, 1};
+    Entry* bounds[nr_children + 1];
+    bounds[0] = first;
+    bounds[nr_children] = last;
+    for(unsigned int d=0, w=nr_children; d<D; d++, w/=2) {
+        for(unsigned int o=0; o<nr_children; o+=w) {
+            bounds[o + w/2] = std::partition(bounds[o], bounds[o + w], [&](const Entry& e) {
+                return e.p[axis[d]] < c[d];
+            });
+        }
+    }
+
+    for(unsigned int o=0; o<nr_children; o++) {
+        #pragma omp task if(bounds[o+1] - bounds[o] >= 4096)
+        this->add_range(node->children[o], bounds[o], bounds[o+1]);
+    }
+    #pragma omp taskwait
+
+    for(unsigned int o=0; o<nr_children; o++) {
+        if(bounds[o+1] != bounds[o]) {
+            const OctreeNode<T, D>* child = node->children[o];
+            node->grow_bounds(child->bmin[0], child->bmin[1], child->bmin[2]);
+            node->grow_bounds(child->bmax[0], child->bmax[1], child->bmax[2]);
+        }
+    }
+}
+
+/**
+ * @brief      add object with a bounding box to a subtree
+ *
+ * @param      top     top of the subtree, its loose box should contain
+ *                     the bounding box
+ * @param      object  pointer to object
+ * @param[in]  _bmin   lower corner of the bounding box
+ * @param[in]  _bmax   upper corner of the bounding box
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::add_box(OctreeNode<T, D>* top, T* object, const double _bmin[3], const double _bmax[3]) {
+    const double c[3] = {(_bmin[0] + _bmax[0]) / 2.0, (_bmin[1] + _bmax[1]) / 2.0, (_bmin[2] + _bmax[2]) / 2.0};
+
+    // only the child holding the center of the box can be the deepest node
+    OctreeNode<T, D>* node = top;
+    while(!node->leaf) {
+        OctreeNode<T, D>* child = node->children[node->get_octant(c[0], c[1], c[2])];
+        if(!child->loose_contains(_bmin, _bmax, this->loose)) {
+            break;
+        }
+        node = child;
+    }
+
+    node->add(object, _bmin, _bmax, this->loose);
+}
+
+/**
+ * @brief      move all objects of a node of another tree and its
+ *             subtree into a node of this tree covering the same cell
+ *
+ * @param      a     node of this tree
+ * @param      b     node of the other tree, left as an empty leaf
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::merge_nodes(OctreeNode<T, D>* a, OctreeNode<T, D>* b) {
+    if(!a->leaf && !b->leaf) {
+        // the boxes held by b did not fit a child of the same cell
+        for(unsigned int i=0; i<b->boxed.size(); i++) {
+            a->store_box(b->boxed[i], &b->boxes[i*6], &b->boxes[i*6+3]);
+        }
+
+        for(unsigned int o=0; o<nr_children; o++) {
+            this->merge_nodes(a->children[o], b->children[o]);
+            OctreeNode<T, D>::destroy(b->children[o]);
+            b->children[o] = nullptr;
+        }
+        b->leaf = true;
+    } else {
+        if(a->leaf && !b->leaf) {
+            // splice the subtree of b into a, such that only the objects
+            // of the leaf a have to be added
+            std::swap(a->objects, b->objects);
+            std::swap(a->pos, b->pos);
+            std::swap(a->qpos, b->qpos);
+            std::swap(a->boxed, b->boxed);
+            std::swap(a->boxes, b->boxes);
+            for(unsigned int o=0; o<nr_children; o++) {
+                a->children[o] = b->children[o];
+                a->children[o]->parent = a;
+                b->children[o] = nullptr;
+            }
+            a->leaf = false;
+            b->leaf = true;
+        }
+
+        double p[3];
+        for(unsigned int i=0; i<b->objects.size(); i++) {
+            b->get_position(i, &p[0], &p[1], &p[2]);
+            a->find_node(p[0], p[1], p[2])->add(b->objects[i], p[0], p[1], p[2], this->loose);
+        }
+        for(unsigned int i=0; i<b->boxed.size(); i++) {
+            this->add_box(a, b->boxed[i], &b->boxes[i*6], &b->boxes[i*6+3]);
+        }
+    }
+
+    b->objects.clear();
+    b->pos.clear();
+    b->qpos.clear();
+    b->boxed.clear();
+    b->boxes.clear();
+}
+
+/**
+ * @brief      append a subtree in van Emde Boas order
+ *
+ * The top half of the levels is laid out first, followed by the
+ * subtrees hanging below it, each recursively.
+ *
+ * @param      node    top of the subtree
+ * @param[in]  height  number of levels to lay out
+ * @param      order   nodes in layout order
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::veb_order(OctreeNode<T, D>* node, unsigned int height, std::vector<OctreeNode<T, D>*>& order) const {
+    if(height <= 1 || node->leaf) {
+        order.push_back(node);
+        return;
+    }
+
+    const unsigned int top = height / 2;
+    this->veb_order(node, top, order);
+
+    // roots of the bottom subtrees, in Morton order
+    std::vector<OctreeNode<T, D>*> frontier(1, node);
+    for(unsigned int d=0; d<top; d++) {
+        std::vector<OctreeNode<T, D>*> next;
+        for(OctreeNode<T, D>* n : frontier) {
+            if(!n->leaf) {
+                next.insert(next.end(), n->children, n->children + nr_children);
+            }
+        }
+        frontier.swap(next);
+    }
+
+    for(OctreeNode<T, D>* n : frontier) {
+        this->veb_order(n, height - top, order);
+    }
+}
+
+/**
+ * @brief      get an object held by a node itself with its box
+ *
+ * @param[in]  node   pointer to node
+ * @param[in]  i      index of the object (objects with a position first)
+ * @param[out] _bmin  lower corner of the box
+ * @param[out] _bmax  upper corner of the box
+ *
+ * @return     pointer to object
+ */
+template <class T, unsigned int D>
+T* Octree<T, D>::get_item(const OctreeNode<T, D>* node, unsigned int i, double _bmin[3], double _bmax[3]) {
+    if(i < node->objects.size()) {
+        node->get_position(i, &_bmin[0], &_bmin[1], &_bmin[2]);
+        std::copy(_bmin, _bmin + 3, _bmax);
+        return node->objects[i];
+    }
+
+    i -= node->objects.size();
+    std::copy(&node->boxes[i*6], &node->boxes[i*6] + 3, _bmin);
+    std::copy(&node->boxes[i*6] + 3, &node->boxes[i*6] + 6, _bmax);
+    return node->boxed[i];
+}
+
+/**
+ * @brief      call a function for every object in a subtree overlapping
+ *             a box
+ *
+ * @param[in]  top    top of the subtree
+ * @param[in]  _bmin  lower corner of the box
+ * @param[in]  _bmax  upper corner of the box
+ * @param[in]  fn     function receiving the object
+ */
+template <class T, unsigned int D>
+template <class F>
+void Octree<T, D>::for_each_overlapping(const OctreeNode<T, D>* top, const double _bmin[3], const double _bmax[3], F fn) const {
+    std::vector<const OctreeNode<T, D>*> stack(1, top);
+    double lo[3], hi[3];
+
+    while(!stack.empty()) {
+        const OctreeNode<T, D>* node = stack.back();
+        stack.pop_back();
+
+        if(!node->bounds_overlap(_bmin, _bmax)) {
+            continue;
+        }
+
+        for(unsigned int i=0; i<node->count(); i++) {
+            T* object = get_item(node, i, lo, hi);
+            if(lo[0] <= _bmax[0] && _bmin[0] <= hi[0] &&
+               lo[1] <= _bmax[1] && _bmin[1] <= hi[1] &&
+               lo[2] <= _bmax[2] && _bmin[2] <= hi[2]) {
+                fn(object);
+            }
+        }
+
+        if(!node->leaf) {
+            for(unsigned int o=0; o<nr_children; o++) {
+                stack.push_back(node->children[o]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief      report the overlapping pairs between the objects held by
+ *             two nodes themselves and their subtrees
+ *
+ * Both nodes are equal, or their subtrees are disjoint. Every pair of
+ * objects in the two subtrees is reported by exactly one step: either one
+ * of the objects is held by a or b itself, or the pair lies in a pair of
+ * children that is pushed onto the stack.
+ *
+ * @param[in]  a      first node
+ * @param[in]  b      second node
+ * @param      stack  node pairs to visit
+ * @param[in]  fn     function receiving both objects of the pair
+ */
+template <class T, unsigned int D>
+void Octree<T, D>::overlap_step(const OctreeNode<T, D>* a, const OctreeNode<T, D>* b,
+                             std::vector<std::pair<const OctreeNode<T, D>*, const OctreeNode<T, D>*>>& stack,
+                             const std::function<void(T*, T*)>& fn) const {
+    if(a != b && !a->bounds_overlap(b->bmin, b->bmax)) {
+        return;
+    }
+
+    double lo[3], hi[3], plo[3], phi[3];
+
+    if(a == b) {
+        for(unsigned int i=0; i<a->count(); i++) {
+            T* object = get_item(a, i, lo, hi);
+
+            for(unsigned int j=i+1; j<a->count(); j++) {
+                T* other = get_item(a, j, plo, phi);
+                if(lo[0] <= phi[0] && plo[0] <= hi[0] &&
+                   lo[1] <= phi[1] && plo[1] <= hi[1] &&
+                   lo[2] <= phi[2] && plo[2] <= hi[2]) {
+                    fn(object, other);
+                }
+            }
+
+            if(!a->leaf) {
+                for(unsigned int o=0; o<nr_children; o++) {
+                    this->for_each_overlapping(a->children[o], lo, hi, [&](T* other) {
+                        fn(object, other);
+                    });
+                }
+            }
+        }
+
+        if(!a->leaf) {
+            for(unsigned int i=0; i<nr_children; i++) {
+                for(unsigned int j=i; j<nr_children; j++) {
+                    stack.emplace_back(a->children[i], a->children[j]);
+                }
+            }
+        }
+        return;
+    }
+
+    // objects of a against the subtree of b
+    for(unsigned int i=0; i<a->count(); i++) {
+        T* object = get_item(a, i, lo, hi);
+        this->for_each_overlapping(b, lo, hi, [&](T* other) {
+            fn(object, other);
+        });
+    }
+
+    if(a->leaf) {
+        return;
+    }
+
+    // objects of b against the descendants of a
+    for(unsigned int i=0; i<b->count(); i++) {
+        T* object = get_item(b, i, lo, hi);
+        for(unsigned int o=0; o<nr_children; o++) {
+            this->for_each_overlapping(a->children[o], lo, hi, [&](T* other) {
+                fn(object, other);
+            });
+        }
+    }
+
+    if(!b->leaf) {
+        for(unsigned int i=0; i<nr_children; i++) {
+            for(unsigned int j=0; j<nr_children; j++) {
+                stack.emplace_back(a->children[i], b->children[j]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief      split coarse neighbors of leaves until no leaf has a face,
+ *             edge or vertex neighbor more than one level coarser
+ *
+ * The balance ripples outward in rounds. In every round the leaves in the
+ * work list (in Morton order) are checked in parallel for coarse
+ * neighbors, after which all marked neighbors are split in parallel; the
+ * new leaves and the leaves that marked a neighbor form the next work list.
+ *
+ * @param[in]  seeds  leaves to start from
+ *
+ * @return     nodes that have been split
+ */
+template <class T, unsigned int D>
+std::vector<OctreeNode<T, D>*> Octree<T, D>::balance_leaves(std::vector<OctreeNode<T, D>*> seeds) {
+    std::vector<OctreeNode<T, D>*> split;
+
+    while(!seeds.empty()) {
+        std::vector<OctreeNode<T, D>*> marked;
+        std::vector<OctreeNode<T, D>*> unbalanced;
+
+        #pragma omp parallel
+        {
+            std::vector<OctreeNode<T, D>*> lmarked;
+            std::vector<OctreeNode<T, D>*> lunbalanced;
+
+            #pragma omp for schedule(dynamic, 64)
+            for(int i=0; i<(int)seeds.size(); i++) {
+                const OctreeNode<T, D>* leaf = seeds[i];
+                if(!leaf->is_leaf()) {
+                    continue;
+                }
+
+                bool found = false;
+                for(unsigned int d=0; d<OctreeNode<T, D>::nr_directions; d++) {
+                    OctreeNode<T, D>* q = leaf->find_gteq_neighbor(d);
+                    if(q != nullptr && q->is_leaf() && q->get_level() + 1 < leaf->get_level()) {
+                        lmarked.push_back(q);
+                        found = true;
+                    }
+                }
+
+                if(found) {
+                    lunbalanced.push_back(seeds[i]);
+                }
+            }
+
+            #pragma omp critical
+            {
+                marked.insert(marked.end(), lmarked.begin(), lmarked.end());
+                unbalanced.insert(unbalanced.end(), lunbalanced.begin(), lunbalanced.end());
+            }
+        }
+
+        std::sort(marked.begin(), marked.end());
+        marked.erase(std::unique(marked.begin(), marked.end()), marked.end());
+
+        // see split() on concurrent splits
+        #pragma omp parallel for schedule(dynamic, 16)
+        for(int i=0; i<(int)marked.size(); i++) {
+            marked[i]->split(this->loose);
+        }
+
+        seeds = std::move(unbalanced);
+        for(OctreeNode<T, D>* node : marked) {
+            for(auto& leaf : OctreeRange<T, D>(node, OT_ORDER_PRE, true, -1)) {
+                seeds.push_back(&leaf);
+            }
+        }
+        split.insert(split.end(), marked.begin(), marked.end());
+    }
+
+    return split;
+}
+
+/**
+ * @brief      evaluate a predicate in parallel on a list of nodes
+ *
+ * @param[in]  nodes  nodes to evaluate
+ * @param[in]  pred   predicate
+ *
+ * @return     nodes for which the predicate holds, in their original order
+ */
+template <class T, unsigned int D>
+std::vector<OctreeNode<T, D>*> Octree<T, D>::select(const std::vector<OctreeNode<T, D>*>& nodes, const std::function<bool(const OctreeNode<T, D>&)>& pred) const {
+    std::vector<char> flags(nodes.size(), 0);
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for(int i=0; i<(int)nodes.size(); i++) {
+        flags[i] = pred(*nodes[i]) ? 1 : 0;
+    }
+
+    std::vector<OctreeNode<T, D>*> selected;
+    for(size_t i=0; i<nodes.size(); i++) {
+        if(flags[i]) {
+            selected.push_back(nodes[i]);
+        }
+    }
+
+    return selected;
+}
+
+/**
+ * @brief      Constructs the object.
+ *
+ * @param      _parent  pointer to parent
+ * @param[in]  _cx      center position x
+ * @param[in]  _cy      center position y
+ * @param[in]  _cz      center position z
+ * @param[in]  _x       width of the cell
+ * @param[in]  _y       breadth of the cell
+ * @param[in]  _z       height of the cell
+ * @param[in]  _level   The level
+ */
+template <class T, unsigned int D>
+OctreeNode<T, D>::OctreeNode(OctreeNode* _parent,
+                          double _cx, double _cy, double _cz,
+                          double _x, double _y, double _z,
+                          unsigned int _level) :
+    cx(_cx),
+    cy(_cy),
+    cz(_cz),
+    x(_x),
+    y(_y),
+    z(_z),
+    parent(_parent),
+    level(_level) {
+
+    if(this->parent != nullptr) {
+        this->qbits = this->parent->qbits;
+    }
+
+    if(this->qbits == 0) {
+        this->pos.reserve(3 * 16);
+    } else {
+        this->qpos.reserve(this->qstride() * 16);
+    }
+    this->objects.reserve(16);
+
+    for(unsigned int k=0; k<3; k++) {
+        this->bmin[k] = std::numeric_limits<double>::infinity();
+        this->bmax[k] = -std::numeric_limits<double>::infinity();
+    }
+}
+
+/**
+ * @brief      split the cell into 8 octants (4 quadrants in 2-D)
+ *
+ * Only this subtree is modified, such that distinct leaves can be split
+ * concurrently.
+ *
+ * @param[in]  loose  looseness factor of the tree (0 to keep the objects
+ *                    with a bounding box in this node)
+ */
+template <class T, unsigned int D>
+void OctreeNode<T, D>::split(double loose) {
+    if(this->children[0] != nullptr) {
+        return;
+    }
+
+    // set node to leaf node
+    this->leaf = false;
+
+    const double nx = this->x / 2.0;
+    const double ny = this->y / 2.0;
+    const unsigned int ll = this->level + 1;
+
+    // the z axis is not subdivided in 2-D
+    const double nz = D == 3 ? this->z / 2.0 : this->z;
+    for(unsigned int o=0; o<nr_children; o++) {
+        const double sx = (o >> (D - 1)) & 1 ? 1.0 : -1.0;
+        const double sy = o & 1 ? 1.0 : -1.0;
+        const double sz = D == 3 ? ((o >> 1) & 1 ? 1.0 : -1.0) : 0.0;
+        this->children[o] = new OctreeNode(this, this->cx + sx * nx / 2.0, this->cy + sy * ny / 2.0, this->cz + sz * nz / 2.0, nx, ny, nz, ll);
+        this->children[o]->type = o;
+    }
+
+    // migrate objects
+    OctreeNode* child;
+    if(this->qbits == 0) {
+        for(unsigned int i=0; i<this->objects.size(); i++) {
+            child = this->find_node(this->pos[i*3], this->pos[i*3+1], this->pos[i*3+2]);
+            child->store(this->objects[i], this->pos[i*3], this->pos[i*3+1], this->pos[i*3+2]);
+        }
+    } else {
+        // the grid of a child is a refinement of the grid of its parent, such
+        // that the quantized positions can be migrated without loss
+        const unsigned int hb = this->qbits - 1;
+        const uint32_t mask = (1u << this->qbits) - 1;
+        uint32_t q[3];
+        for(unsigned int i=0; i<this->objects.size(); i++) {
+            this->get_quantized(i, q);
+            unsigned int o = 0;
+            for(unsigned int k=0; k<3; k++) {
+                const int b = OctreeTables<D>::axis_bit(k);
+                if(b >= 0) {
+                    o |= (q[k] >> hb) << b;
+                    q[k] = (q[k] << 1) & mask;
+                }
+            }
+            this->children[o]->store_quantized(this->objects[i], q);
+        }
+    }
+
+    this->objects.clear();
+    this->pos.clear();
+    this->qpos.clear();
+
+    // objects with a bounding box move to the child holding their center
+    // if its loose box contains them, else they stay in this node
+    if(loose >= 1.0) {
+        std::vector<T*> kept;
+        std::vector<double, OctreeAllocator<double>> kept_boxes(this->boxes.get_allocator());
+        for(unsigned int i=0; i<this->boxed.size(); i++) {
+            const double* b = &this->boxes[i*6];
+            child = this->children[this->get_octant((b[0] + b[3]) / 2.0, (b[1] + b[4]) / 2.0, (b[2] + b[5]) / 2.0)];
+            if(child->loose_contains(b, b + 3, loose)) {
+                child->store_box(this->boxed[i], b, b + 3);
+            } else {
+                kept.push_back(this->boxed[i]);
+                kept_boxes.insert(kept_boxes.end(), b, b + 6);
+            }
+        }
+        this->boxed.swap(kept);
+        this->boxes.swap(kept_boxes);
+    }
+
+    for(unsigned int o=0; o<nr_children; o++) {
+        if(this->children[o]->count() >= 16 && ll < max_level) {
+            this->children[o]->split(loose);
+        }
+    }
+}
+
+/**
+ * @brief      merge the children into this node
+ *
+ * All children should be leaves. Only this subtree is modified.
+ */
+template <class T, unsigned int D>
+void OctreeNode<T, D>::merge() {
+    if(this->leaf) {
+        return;
+    }
+
+    for(unsigned int o=0; o<nr_children; o++) {
+        OctreeNode* child = this->children[o];
+
+        if(this->qbits == 0) {
+            for(unsigned int i=0; i<child->objects.size(); i++) {
+                this->objects.push_back(child->objects[i]);
+                this->pos.insert(this->pos.end(), &child->pos[i*3], &child->pos[i*3] + 3);
+            }
+        } else {
+            // map the grid of the child onto the (coarser) grid of this node
+            const uint32_t hb = 1u << (this->qbits - 1);
+            uint32_t q[3];
+            for(unsigned int i=0; i<child->objects.size(); i++) {
+                child->get_quantized(i, q);
+                for(unsigned int k=0; k<3; k++) {
+                    const int b = OctreeTables<D>::axis_bit(k);
+                    if(b >= 0) {
+                        q[k] = (q[k] >> 1) + ((o >> b) & 1 ? hb : 0);
+                    }
+                }
+                this->objects.push_back(child->objects[i]);
+                this->push_quantized(q);
+            }
+        }
+
+        // the loose box of this node contains the loose boxes of its children
+        this->boxed.insert(this->boxed.end(), child->boxed.begin(), child->boxed.end());
+        this->boxes.insert(this->boxes.end(), child->boxes.begin(), child->boxes.end());
+
+        destroy(child);
+        this->children[o] = nullptr;
+    }
+
+    this->leaf = true;
+    this->update_bounds();
+}
+
+/**
+ * @brief      add object to node
+ *
+ * @param      object  pointer to object
+ * @param[in]  _px     object position x
+ * @param[in]  _py     object position y
+ * @param[in]  _pz     object position z
+ * @param[in]  loose   looseness factor of the tree (0 to keep the objects
+ *                     with a bounding box in this node upon a split)
+ */
+template <class T, unsigned int D>
+void OctreeNode<T, D>::add(T* object, double _px, double _py, double _pz, double loose) {
+    if(this->leaf) {
+        this->store(object, _px, _py, _pz);
+
+        if(this->parent != nullptr) {
+            double qx, qy, qz;
+            this->get_position(this->objects.size() - 1, &qx, &qy, &qz);
+            this->parent->expand_bounds(qx, qy, qz);
+        }
+
+        if(this->count() >= 16 && this->level < max_level) {
+            this->split(loose);
+        }
+    }
+}
+
+/**
+ * @brief      add object with a bounding box to node
+ *
+ * The box should lie within the loose box of the node.
+ *
+ * @param      object  pointer to object
+ * @param[in]  _bmin   lower corner of the bounding box
+ * @param[in]  _bmax   upper corner of the bounding box
+ * @param[in]  loose   looseness factor of the tree
+ */
+template <class T, unsigned int D>
+void OctreeNode<T, D>::add(T* object, const double _bmin[3], const double _bmax[3], double loose) {
+    this->store_box(object, _bmin, _bmax);
+
+    if(this->parent != nullptr) {
+        this->parent->expand_bounds(_bmin[0], _bmin[1], _bmin[2]);
+        this->parent->expand_bounds(_bmax[0], _bmax[1], _bmax[2]);
+    }
+
+    if(this->leaf && this->count() >= 16 && this->level < max_level) {
+        this->split(loose);
+    }
+}
+
+/**
+ * @brief      get position of an object
+ *
+ * In compact mode, the position is decoded from the quantized offset
+ * with respect to the cell.
+ *
+ * @param[in]  i     index of the object
+ * @param[out] _px   object position x
+ * @param[out] _py   object position y
+ * @param[out] _pz   object position z
+ */
+template <class T, unsigned int D>
+void OctreeNode<T, D>::get_position(unsigned int i, double* _px, double* _py, double* _pz) const {
+    if(this->qbits == 0) {
+        *_px = this->pos[i*3];
+        *_py = this->pos[i*3+1];
+        *_pz = this->pos[i*3+2];
+        return;
+    }
+
+    uint32_t q[3];
+    this->get_quantized(i, q);
+    const double f = 1.0 / (double)(1u << this->qbits);
+    *_px = this->cx - this->x / 2.0 + q[0] * f * this->x;
+    *_py = this->cy - this->y / 2.0 + q[1] * f * this->y;
+    *_pz = this->cz - this->z / 2.0 + q[2] * f * this->z;
 }
 
 /**
- * @brief      Constructs the object.
+ * @brief      recalculate the bounding box of the contents
  *
- * @param      _parent  pointer to parent
- * @param[in]  _cx      center position x
- * @param[in]  _cy      center position y
- * @param[in]  _cz      center position z
- * @param[in]  _x       width of the cell
- * @param[in]  _y       breadth of the cell
- * @param[in]  _z       height of the cell
- * @param[in]  _level   The level
+ * Uses the positions of the objects for a leaf and the bounding boxes
+ * of the children otherwise; the latter should be up to date. The boxes
+ * of the objects with a bounding box held by the node are included.
  */
-template <class T>
-OctreeNode<T>::OctreeNode(OctreeNode* _parent,
-                          double _cx, double _cy, double _cz,
-                          double _x, double _y, double _z,
-                          unsigned int _level) :
-    parent(_parent),
-    cx(_cx),
-    cy(_cy),
-    cz(_cz),
-    x(_x),
-    y(_y),
-    z(_z),
-    level(_level) {
+template <class T, unsigned int D>
+void OctreeNode<T, D>::update_bounds() {
+    for(unsigned int k=0; k<3; k++) {
+        this->bmin[k] = std::numeric_limits<double>::infinity();
+        this->bmax[k] = -std::numeric_limits<double>::infinity();
+    }
 
-    this->pos.reserve(3 * 16);
-    this->objects.reserve(16);
+    for(unsigned int i=0; i<this->boxed.size(); i++) {
+        this->grow_bounds(this->boxes[i*6], this->boxes[i*6+1], this->boxes[i*6+2]);
+        this->grow_bounds(this->boxes[i*6+3], this->boxes[i*6+4], this->boxes[i*6+5]);
+    }
+
+    if(!this->leaf) {
+        for(unsigned int o=0; o<nr_children; o++) {
+            for(unsigned int k=0; k<3; k++) {
+                this->bmin[k] = std::min(this->bmin[k], this->children[o]->bmin[k]);
+                this->bmax[k] = std::max(this->bmax[k], this->children[o]->bmax[k]);
+            }
+        }
+        return;
+    }
+
+    double p[3];
+    for(unsigned int i=0; i<this->objects.size(); i++) {
+        this->get_position(i, &p[0], &p[1], &p[2]);
+        for(unsigned int k=0; k<3; k++) {
+            this->bmin[k] = std::min(this->bmin[k], p[k]);
+            this->bmax[k] = std::max(this->bmax[k], p[k]);
+        }
+    }
 }
 
 /**
- * @brief      split the cell into 8 octants
+ * @brief      squared distance from a position to the bounding box of
+ *             the contents
+ *
+ * @param[in]  _px   position x
+ * @param[in]  _py   position y
+ * @param[in]  _pz   position z
+ *
+ * @return     squared distance (infinity if the node holds no objects)
  */
-template <class T>
-void OctreeNode<T>::split() {
-    if(this->children[0] != nullptr) {
-        return;
+template <class T, unsigned int D>
+double OctreeNode<T, D>::bounds_distance2(double _px, double _py, double _pz) const {
+    if(this->is_empty()) {
+        return std::numeric_limits<double>::infinity();
     }
 
-    // set node to leaf node
-    this->leaf = false;
+    const double p[3] = {_px, _py, _pz};
+    double d2 = 0.0;
+    for(unsigned int k=0; k<3; k++) {
+        const double d = std::max(std::max(this->bmin[k] - p[k], p[k] - this->bmax[k]), 0.0);
+        d2 += d * d;
+    }
 
-    const double nx = this->x / 2.0;
-    const double ny = this->y / 2.0;
-    const double nz = this->z / 2.0;
-    const unsigned int ll = this->level + 1;
+    return d2;
+}
 
-    this->children[OT_LDB] = new OctreeNode(this, this->cx - nx / 2.0, this->cy - ny / 2.0, this->cz - nz / 2.0, nx, ny, nz, ll);
-    this->children[OT_LDF] = new OctreeNode(this, this->cx - nx / 2.0, this->cy + ny / 2.0, this->cz - nz / 2.0, nx, ny, nz, ll);
-    this->children[OT_LUB] = new OctreeNode(this, this->cx - nx / 2.0, this->cy - ny / 2.0, this->cz + nz / 2.0, nx, ny, nz, ll);
-    this->children[OT_LUF] = new OctreeNode(this, this->cx - nx / 2.0, this->cy + ny / 2.0, this->cz + nz / 2.0, nx, ny, nz, ll);
-    this->children[OT_RDB] = new OctreeNode(this, this->cx + nx / 2.0, this->cy - ny / 2.0, this->cz - nz / 2.0, nx, ny, nz, ll);
-    this->children[OT_RDF] = new OctreeNode(this, this->cx + nx / 2.0, this->cy + ny / 2.0, this->cz - nz / 2.0, nx, ny, nz, ll);
-    this->children[OT_RUB] = new OctreeNode(this, this->cx + nx / 2.0, this->cy - ny / 2.0, this->cz + nz / 2.0, nx, ny, nz, ll);
-    this->children[OT_RUF] = new OctreeNode(this, this->cx + nx / 2.0, this->cy + ny / 2.0, this->cz + nz / 2.0, nx, ny, nz, ll);
+/**
+ * @brief      squared distance between the bounding boxes of the
+ *             contents of two nodes
+ *
+ * @param[in]  other  pointer to other node
+ *
+ * @return     squared distance (infinity if either node holds no objects)
+ */
+template <class T, unsigned int D>
+double OctreeNode<T, D>::bounds_distance2(const OctreeNode* other) const {
+    if(this->is_empty() || other->is_empty()) {
+        return std::numeric_limits<double>::infinity();
+    }
 
-    // migrate objects
-    for(unsigned int i=0; i<this->objects.size(); i++) {
-        this->find_node(this->pos[i*3], this->pos[i*3+1], this->pos[i*3+2])->add(this->objects[i], this->pos[i*3], this->pos[i*3+1], this->pos[i*3+2]);
+    double d2 = 0.0;
+    for(unsigned int k=0; k<3; k++) {
+        const double d = std::max(std::max(this->bmin[k] - other->bmax[k], other->bmin[k] - this->bmax[k]), 0.0);
+        d2 += d * d;
     }
 
-    this->objects.clear();
-    this->pos.clear();
+    return d2;
 }
 
 /**
- * @brief      add object to node
+ * @brief      whether a box overlaps the bounding box of the contents
  *
- * @param      object  pointer to object
- * @param[in]  _px     object position x
- * @param[in]  _py     object position y
- * @param[in]  _pz     object position z
+ * @param[in]  _bmin  lower corner of the box
+ * @param[in]  _bmax  upper corner of the box
+ *
+ * @return     true if the boxes overlap (false if the node holds no objects)
  */
-template <class T>
-void OctreeNode<T>::add(T* object, double _px, double _py, double _pz) {
-    if(this->leaf) {
-        this->objects.push_back(object);
-        this->pos.push_back(_px);
-        this->pos.push_back(_py);
-        this->pos.push_back(_pz);
-
-        if(this->objects.size() >= 16) {
-            this->split();
+template <class T, unsigned int D>
+bool OctreeNode<T, D>::bounds_overlap(const double _bmin[3], const double _bmax[3]) const {
+    for(unsigned int k=0; k<3; k++) {
+        if(this->bmin[k] > _bmax[k] || _bmin[k] > this->bmax[k]) {
+            return false;
         }
     }
+
+    return true;
 }
 
 /**
- * @brief      get the octant type
+ * @brief      whether a box lies within the loose box of the cell
+ *
+ * The loose box shares its center with the cell and is larger by the
+ * looseness factor.
  *
- * @return     octant type
+ * @param[in]  _bmin  lower corner of the box
+ * @param[in]  _bmax  upper corner of the box
+ * @param[in]  loose  looseness factor of the tree
+ *
+ * @return     true if the box is contained
  */
-template <class T>
-unsigned int OctreeNode<T>::get_type() const {
-    if(this->get_parent() == nullptr) {
-        return OT_ROOT;
-    }
+template <class T, unsigned int D>
+bool OctreeNode<T, D>::loose_contains(const double _bmin[3], const double _bmax[3], double loose) const {
+    const double c[3] = {this->cx, this->cy, this->cz};
+    const double h[3] = {loose * this->x / 2.0, loose * this->y / 2.0, loose * this->z / 2.0};
 
-    for(unsigned int i=0; i<8; i++) {
-        if(this->get_parent()->get_child(i) == this) {
-            return i;
+    for(unsigned int k=0; k<3; k++) {
+        if(_bmin[k] < c[k] - h[k] || _bmax[k] > c[k] + h[k]) {
+            return false;
         }
     }
+
+    return true;
 }
 
 /**
- * @brief      find node given position
+ * @brief      expand the bounding box of this node and its ancestors
  *
  * @param[in]  _px   position x
  * @param[in]  _py   position y
  * @param[in]  _pz   position z
+ */
+template <class T, unsigned int D>
+void OctreeNode<T, D>::expand_bounds(double _px, double _py, double _pz) {
+    // stop as soon as an ancestor already encloses the position
+    for(OctreeNode* n = this; n != nullptr && n->grow_bounds(_px, _py, _pz); n = n->parent) {}
+}
+
+/**
+ * @brief      expand the bounding box of this node only
  *
- * @return     pointer to node
+ * @param[in]  _px   position x
+ * @param[in]  _py   position y
+ * @param[in]  _pz   position z
+ *
+ * @return     true if the bounding box has grown
  */
-template <class T>
-OctreeNode<T>* OctreeNode<T>::find_node(double _px, double _py, double _pz) {
-    if(this->leaf) {
-        return this;
-    }
+template <class T, unsigned int D>
+bool OctreeNode<T, D>::grow_bounds(double _px, double _py, double _pz) {
+    const double p[3] = {_px, _py, _pz};
+    bool grown = false;
 
-    if(_px < this->cx) { // L
-        if(_pz < this->cz) { // D
-            if(_py < this->cy) { // B
-                return this->children[OT_LDB]->find_node(_px, _py, _pz);
-            } else { // F
-                return this->children[OT_LDF]->find_node(_px, _py, _pz);
-            }
-        } else { // U
-            if(_py < this->cy) { // B
-                return this->children[OT_LUB]->find_node(_px, _py, _pz);
-            } else { // F
-                return this->children[OT_LUF]->find_node(_px, _py, _pz);
-            }
+    for(unsigned int k=0; k<3; k++) {
+        if(p[k] < this->bmin[k]) {
+            this->bmin[k] = p[k];
+            grown = true;
         }
-    } else { // R
-        if(_pz < this->cz) { // D
-            if(_py < this->cy) { // B
-                return this->children[OT_RDB]->find_node(_px, _py, _pz);
-            } else { // F
-                return this->children[OT_RDF]->find_node(_px, _py, _pz);
-            }
-        } else { // U
-            if(_py < this->cy) { // B
-                return this->children[OT_RUB]->find_node(_px, _py, _pz);
-            } else { // F
-                return this->children[OT_RUF]->find_node(_px, _py, _pz);
-            }
+        if(p[k] > this->bmax[k]) {
+            this->bmax[k] = p[k];
+            grown = true;
         }
     }
+
+    return grown;
 }
 
 /**
- * @brief      find neighbors
+ * @brief      change the storage of the positions in this node
  *
- * @return     vector holding pointers to neighbor nodes
+ * @param[in]  bits  bits per coordinate (16 or 21), 0 for full precision
  */
-template <class T>
-std::vector<OctreeNode<T>*> OctreeNode<T>::find_neighbors() const {
-    std::unordered_set<OctreeNode<T>*> neighbors;
-    neighbors.reserve(26);
-    OctreeNode<T>* q;
+template <class T, unsigned int D>
+void OctreeNode<T, D>::set_qbits(unsigned int bits) {
+    if(this->qbits != 0 && bits != 0) {
+        // the grids are nested, such that the quantized positions can be
+        // shifted without rounding
+        std::vector<uint32_t> q(this->objects.size() * 3);
+        for(unsigned int i=0; i<this->objects.size(); i++) {
+            this->get_quantized(i, &q[i*3]);
+        }
 
-    // find face neighbors
-    for(unsigned int i=0; i<6; i++) {
-        q = this->find_gteq_neighbor_face(i);
-        if(q != nullptr) {
-            neighbors.insert(q);
+        const unsigned int from = this->qbits;
+        this->qbits = bits;
+        this->qpos.clear();
+        this->qpos.shrink_to_fit();
+        for(unsigned int i=0; i<this->objects.size(); i++) {
+            for(unsigned int k=0; k<3; k++) {
+                q[i*3+k] = bits > from ? q[i*3+k] << (bits - from) : q[i*3+k] >> (from - bits);
+            }
+            this->push_quantized(&q[i*3]);
         }
+        return;
     }
 
-    // find edge neighbors
-    for(unsigned int i=6; i<18; i++) {
-        q = this->find_gteq_neighbor_face(i);
-        if(q != nullptr) {
-            neighbors.insert(q);
-        }
+    std::vector<double> p(this->objects.size() * 3);
+    for(unsigned int i=0; i<this->objects.size(); i++) {
+        this->get_position(i, &p[i*3], &p[i*3+1], &p[i*3+2]);
     }
 
-    // find vertex neighbors
-    for(unsigned int i=18; i<26; i++) {
-        q = this->find_gteq_neighbor_face(i);
-        if(q != nullptr) {
-            neighbors.insert(q);
+    this->qbits = bits;
+    this->pos.clear();
+    this->qpos.clear();
+    this->pos.shrink_to_fit();
+    this->qpos.shrink_to_fit();
+
+    if(this->qbits == 0) {
+        this->pos.assign(p.begin(), p.end());
+    } else {
+        for(unsigned int i=0; i<this->objects.size(); i++) {
+            const uint32_t q[3] = {this->quantize(p[i*3], this->cx, this->x),
+                                   this->quantize(p[i*3+1], this->cy, this->y),
+                                   this->quantize(p[i*3+2], this->cz, this->z)};
+            this->push_quantized(q);
         }
     }
+}
+
+/**
+ * @brief      append object to the storage of this node
+ *
+ * Only the bounding box of this node is updated.
+ *
+ * @param      object  pointer to object
+ * @param[in]  _px     object position x
+ * @param[in]  _py     object position y
+ * @param[in]  _pz     object position z
+ */
+template <class T, unsigned int D>
+void OctreeNode<T, D>::store(T* object, double _px, double _py, double _pz) {
+    if(this->qbits != 0) {
+        const uint32_t q[3] = {this->quantize(_px, this->cx, this->x),
+                               this->quantize(_py, this->cy, this->y),
+                               this->quantize(_pz, this->cz, this->z)};
+        this->store_quantized(object, q);
+        return;
+    }
 
-    return std::vector<OctreeNode<T>*>(neighbors.begin(), neighbors.end());
+    this->objects.push_back(object);
+    this->pos.push_back(_px);
+    this->pos.push_back(_py);
+    this->pos.push_back(_pz);
+    this->grow_bounds(_px, _py, _pz);
 }
 
 /**
- * @brief      find face neighbor (equal or larger in size) in direction i
+ * @brief      append object to the storage of this node given its
+ *             quantized position
  *
- * @param[in]  i     direction i
+ * Only the bounding box of this node is updated.
  *
- * @return     pointer to face neighbor
+ * @param      object  pointer to object
+ * @param[in]  q       quantized position
  */
-template <class T>
-OctreeNode<T>* OctreeNode<T>::find_gteq_neighbor_face(unsigned int i) const {
-    OctreeNode<T>* q;
-    const unsigned int type = this->get_type();
+template <class T, unsigned int D>
+void OctreeNode<T, D>::store_quantized(T* object, const uint32_t q[3]) {
+    this->objects.push_back(object);
+    this->push_quantized(q);
 
-    if(this->parent != nullptr && this->adj(i, type)) {
-        q = this->parent->find_gteq_neighbor_face(i);
-    } else {
-        q = this->parent;
-    }
+    double qx, qy, qz;
+    this->get_position(this->objects.size() - 1, &qx, &qy, &qz);
+    this->grow_bounds(qx, qy, qz);
+}
 
-    if(q != nullptr && !q->is_leaf()) {
-        return q->get_child(this->reflect(i, type));
-    } else {
-        return q;
-    }
+/**
+ * @brief      append object with a bounding box to the storage of this
+ *             node
+ *
+ * Only the bounding box of this node is updated.
+ *
+ * @param      object  pointer to object
+ * @param[in]  _bmin   lower corner of the bounding box
+ * @param[in]  _bmax   upper corner of the bounding box
+ */
+template <class T, unsigned int D>
+void OctreeNode<T, D>::store_box(T* object, const double _bmin[3], const double _bmax[3]) {
+    this->boxed.push_back(object);
+    this->boxes.insert(this->boxes.end(), _bmin, _bmin + 3);
+    this->boxes.insert(this->boxes.end(), _bmax, _bmax + 3);
+    this->grow_bounds(_bmin[0], _bmin[1], _bmin[2]);
+    this->grow_bounds(_bmax[0], _bmax[1], _bmax[2]);
 }
 
 /**
- * @brief      find edge neighbor (equal or larger in size) in direction i
+ * @brief      quantize coordinate on the grid of the cell
  *
- * @param[in]  i     direction i
+ * @param[in]  p     coordinate
+ * @param[in]  c     center of the cell
+ * @param[in]  l     length of the cell
  *
- * @return     pointer to edge neighbor
+ * @return     quantized coordinate
  */
-template <class T>
-OctreeNode<T>* OctreeNode<T>::find_gteq_neighbor_edge(unsigned int i) const {
-    OctreeNode<T>* q;
-    const unsigned int type = this->get_type();
+template <class T, unsigned int D>
+uint32_t OctreeNode<T, D>::quantize(double p, double c, double l) const {
+    const uint32_t n = 1u << this->qbits;
+    const double t = std::floor((p - c + l / 2.0) / l * n);
 
-    if(this->parent == nullptr) {
-        q = nullptr;
-    } else if(this->adj(i, type)) {
-        q = this->parent->find_gteq_neighbor_edge(i);
-    } else if(this->common_face(i, type) != OT_D_UNKNOWN) {
-        q = this->parent->find_gteq_neighbor_face(this->common_face(i, type));
+    if(t < 0.0) {
+        return 0;
+    }
+    if(t >= n) {
+        return n - 1;
+    }
+
+    return (uint32_t)t;
+}
+
+/**
+ * @brief      append quantized position to storage
+ *
+ * @param[in]  q     quantized position
+ */
+template <class T, unsigned int D>
+void OctreeNode<T, D>::push_quantized(const uint32_t q[3]) {
+    unsigned char buf[8];
+
+    if(this->qbits == 16) {
+        const uint16_t v[3] = {(uint16_t)q[0], (uint16_t)q[1], (uint16_t)q[2]};
+        std::memcpy(buf, v, 6);
     } else {
-        q = parent;
+        const uint64_t v = ((uint64_t)q[0] << 42) | ((uint64_t)q[1] << 21) | (uint64_t)q[2];
+        std::memcpy(buf, &v, 8);
     }
 
-    if(q != nullptr && !q->is_leaf()) {
-        return q->get_child(this->reflect(i, type));
+    this->qpos.insert(this->qpos.end(), buf, buf + this->qstride());
+}
+
+/**
+ * @brief      read quantized position from storage
+ *
+ * @param[in]  i     index of the object
+ * @param[out] q     quantized position
+ */
+template <class T, unsigned int D>
+void OctreeNode<T, D>::get_quantized(unsigned int i, uint32_t q[3]) const {
+    const unsigned char* buf = &this->qpos[i * this->qstride()];
+
+    if(this->qbits == 16) {
+        uint16_t v[3];
+        std::memcpy(v, buf, 6);
+        q[0] = v[0];
+        q[1] = v[1];
+        q[2] = v[2];
     } else {
-        return q;
+        uint64_t v;
+        std::memcpy(&v, buf, 8);
+        q[0] = (uint32_t)(v >> 42) & 0x1fffff;
+        q[1] = (uint32_t)(v >> 21) & 0x1fffff;
+        q[2] = (uint32_t)v & 0x1fffff;
     }
 }
 
 /**
- * @brief      find vertex neighbor (equal or larger in size) in direction i
+ * @brief      find node given position
+ *
+ * @param[in]  _px   position x
+ * @param[in]  _py   position y
+ * @param[in]  _pz   position z
  *
- * @param[in]  i     direction i
+ * @return     pointer to node
+ */
+template <class T, unsigned int D>
+OctreeNode<T, D>* OctreeNode<T, D>::find_node(double _px, double _py, double _pz) {
+    OctreeNode* node = this;
+    while(!node->leaf) {
+        node = node->children[node->get_octant(_px, _py, _pz)];
+    }
+
+    return node;
+}
+
+/**
+ * @brief      find neighbors
  *
- * @return     pointer to vertex neighbor
+ * @return     vector holding pointers to neighbor nodes
  */
-template <class T>
-OctreeNode<T>* OctreeNode<T>::find_gteq_neighbor_vertex(unsigned int i) const {
-    OctreeNode<T>* q;
-    const unsigned int type = this->get_type();
+template <class T, unsigned int D>
+std::vector<OctreeNode<T, D>*> OctreeNode<T, D>::find_neighbors() const {
+    std::unordered_set<OctreeNode<T, D>*> neighbors;
+    neighbors.reserve(nr_directions);
+
+    for(unsigned int i=0; i<nr_directions; i++) {
+        OctreeNode<T, D>* q = this->find_gteq_neighbor(i);
+        if(q != nullptr) {
+            neighbors.insert(q);
+        }
+    }
+
+    return std::vector<OctreeNode<T, D>*>(neighbors.begin(), neighbors.end());
+}
 
+/**
+ * @brief      find neighbor (equal or larger in size) in direction i
+ *
+ * Ascends while the node lies on the side of its parent along any axis
+ * of the direction, continuing with the direction restricted to those
+ * axes, and descends along the reflected octants.
+ *
+ * @param[in]  i     direction i (face, edge or vertex direction)
+ *
+ * @return     pointer to neighbor
+ */
+template <class T, unsigned int D>
+OctreeNode<T, D>* OctreeNode<T, D>::find_gteq_neighbor(unsigned int i) const {
     if(this->parent == nullptr) {
-        q = nullptr;
-    } else if(this->adj(i, type)) {
-        q = this->parent->find_gteq_neighbor_vertex(i);
-    } else if(this->common_edge(i, type) != OT_D_UNKNOWN) {
-        q = this->parent->find_gteq_neighbor_edge(this->common_edge(i, type));
-    } else if(this->common_face(i, type) != OT_D_UNKNOWN) {
-        q = this->parent->find_gteq_neighbor_face(this->common_face(i, type));
-    } else {
-        q = parent;
+        return nullptr;
     }
 
-    if(q != nullptr && !q->is_leaf()) {
-        return q->get_child(this->reflect(i, type));
+    const unsigned int type = this->type;
+    const unsigned int c = this->common(i, type);
+    OctreeNode<T, D>* q = c == nr_directions ? this->parent : this->parent->find_gteq_neighbor(c);
+
+    if(q != nullptr && !q->leaf) {
+        return q->children[this->reflect(i, type)];
     } else {
         return q;
     }
 }
 
+/**
+ * @brief      whether node shares a face, edge or vertex with another node
+ *
+ * @param[in]  other  pointer to other node
+ *
+ * @return     true if the cells touch or overlap, false otherwise
+ */
+template <class T, unsigned int D>
+bool OctreeNode<T, D>::touches(const OctreeNode* other) const {
+    const double eps = 1e-9 * (this->x + this->y + this->z);
+
+    return std::fabs(this->cx - other->cx) <= (this->x + other->x) / 2.0 + eps &&
+           std::fabs(this->cy - other->cy) <= (this->y + other->y) / 2.0 + eps &&
+           std::fabs(this->cz - other->cz) <= (this->z + other->z) / 2.0 + eps;
+}
+
 /**
  * @brief      print the tree
  */
-template <class T>
-void OctreeNode<T>::print() {
+template <class T, unsigned int D>
+void OctreeNode<T, D>::print() {
     for(unsigned int j=0; j<this->level; j++) {
         std::cout << "\t";
     }
     std::cout << "(" << this->level << ") " << this->cx << "  " << this->cy << "  " << this->cz << "  " << this->get_type() << "  " << this << std::endl;
 
     if(!this->leaf) {
-        for(unsigned int i=0; i<8; i++) {
+        for(unsigned int i=0; i<nr_children; i++) {
             this->children[i]->print();
         }
     }
@@ -369,156 +2113,198 @@ void OctreeNode<T>::print() {
 /**
  * @brief      Destroys the object.
  */
-template <class T>
-OctreeNode<T>::~OctreeNode() {
-    if(!this->leaf) {
-        delete[] this->children;
-    }
-}
-
-/**
- * @brief      check if octant is adjacent to direction
- *
- * @param[in]  i     direction
- * @param[in]  o     octant
- *
- * @return     true if adjacent, false otherwise
- */
-template <class T>
-bool OctreeNode<T>::adj(unsigned int i, unsigned int o) const {
-    static const bool table[26][8] = {
-        {1,1,1,1,0,0,0,0}, // L
-        {0,0,0,0,1,1,1,1}, // R
-        {1,1,0,0,1,1,0,0}, // D
-        {0,0,1,1,0,0,1,1}, // U
-        {1,0,1,0,1,0,1,0}, // B
-        {0,1,0,1,0,1,0,1}, // F
-        {1,1,0,0,0,0,0,0}, // LD
-        {0,0,1,1,0,0,0,0}, // LU
-        {1,0,1,0,0,0,0,0}, // LB
-        {0,1,0,1,0,0,0,0}, // LF
-        {0,0,0,0,1,1,0,0}, // RD
-        {0,0,0,0,0,0,1,1}, // RU
-        {0,0,0,0,1,0,1,0}, // RB
-        {0,0,0,0,0,1,0,1}, // RF
-        {1,0,0,0,1,0,0,0}, // DB
-        {0,1,0,0,0,1,0,0}, // DF
-        {0,0,1,0,0,0,1,0}, // UB
-        {0,0,0,1,0,0,0,1}, // UF
-        {1,0,0,0,0,0,0,0}, // LDB
-        {0,1,0,0,0,0,0,0}, // LDF
-        {0,0,1,0,0,0,0,0}, // LUB
-        {0,0,0,1,0,0,0,0}, // LUF
-        {0,0,0,0,1,0,0,0}, // RDB
-        {0,0,0,0,0,1,0,0}, // RDF
-        {0,0,0,0,0,0,1,0}, // RUB
-        {0,0,0,0,0,0,0,1}  // RUF
-    };
+template <class T, unsigned int D>
+OctreeNode<T, D>::~OctreeNode() {
+    for(unsigned int i=0; i<nr_children; i++) {
+        destroy(this->children[i]);
+    }
+}
 
-    return table[i][o];
-}
-
-/**
- * @brief      determines neighboring octant label in direction i
- *
- * @param[in]  i     direction
- * @param[in]  o     octant
- *
- * @return     octant label
- */
-template <class T>
-unsigned int OctreeNode<T>::reflect(unsigned int i, unsigned int o) const {
-    static const unsigned int table[28][8] = {
-        {OT_RDB, OT_RDF, OT_RUB, OT_RUF, OT_LDB, OT_LDF, OT_LUB, OT_LUF}, // L
-        {OT_RDB, OT_RDF, OT_RUB, OT_RUF, OT_LDB, OT_LDF, OT_LUB, OT_LUF}, // R
-        {OT_LUB, OT_LUF, OT_LDB, OT_LDF, OT_RUB, OT_RUF, OT_RDB, OT_RDF}, // D
-        {OT_LUB, OT_LUF, OT_LDB, OT_LDF, OT_RUB, OT_RUF, OT_RDB, OT_RDF}, // U
-        {OT_LDF, OT_LDB, OT_LUF, OT_LUB, OT_RDF, OT_RDB, OT_RUF, OT_RUB}, // B
-        {OT_LDF, OT_LDB, OT_LUF, OT_LUB, OT_RDF, OT_RDB, OT_RUF, OT_RUB}, // F
-        {OT_RUB, OT_RUF, OT_RDB, OT_RDF, OT_LUB, OT_LUF, OT_LDB, OT_LDF}, // LD
-        {OT_RUB, OT_RUF, OT_RDB, OT_RDF, OT_LUB, OT_LUF, OT_LDB, OT_LDF}, // LU
-        {OT_RDF, OT_RDB, OT_RUF, OT_RUB, OT_LDF, OT_LDB, OT_LUF, OT_LUB}, // LB
-        {OT_RDF, OT_RDB, OT_RUF, OT_RUB, OT_LDF, OT_LDB, OT_LUF, OT_LUB}, // LF
-        {OT_RUB, OT_RUF, OT_RDB, OT_RDF, OT_LUB, OT_LUF, OT_LDB, OT_LDF}, // RD
-        {OT_RUB, OT_RUF, OT_RDB, OT_RDF, OT_LUB, OT_LUF, OT_LDB, OT_LDF}, // RU
-        {OT_RDF, OT_RDB, OT_RUF, OT_RUB, OT_LDF, OT_LDB, OT_LUF, OT_LUB}, // RB
-        {OT_RDF, OT_RDB, OT_RUF, OT_RUB, OT_LDF, OT_LDB, OT_LUF, OT_LUB}, // RF
-        {OT_LUF, OT_LUB, OT_LDF, OT_LDB, OT_RUF, OT_RUB, OT_RDF, OT_RDB}, // DB
-        {OT_LUF, OT_LUB, OT_LDF, OT_LDB, OT_RUF, OT_RUB, OT_RDF, OT_RDB}, // DF
-        {OT_LUF, OT_LUB, OT_LDF, OT_LDB, OT_RUF, OT_RUB, OT_RDF, OT_RDB}, // UB
-        {OT_LUF, OT_LUB, OT_LDF, OT_LDB, OT_RUF, OT_RUB, OT_RDF, OT_RDB}, // UF
-        {OT_RUF, OT_RUB, OT_RDF, OT_RDB, OT_LUF, OT_LUB, OT_LDF, OT_LDB}, // LDB
-        {OT_RUF, OT_RUB, OT_RDF, OT_RDB, OT_LUF, OT_LUB, OT_LDF, OT_LDB}, // LDF
-        {OT_RUF, OT_RUB, OT_RDF, OT_RDB, OT_LUF, OT_LUB, OT_LDF, OT_LDB}, // LUB
-        {OT_RUF, OT_RUB, OT_RDF, OT_RDB, OT_LUF, OT_LUB, OT_LDF, OT_LDB}, // LUF
-        {OT_RUF, OT_RUB, OT_RDF, OT_RDB, OT_LUF, OT_LUB, OT_LDF, OT_LDB}, // RDB
-        {OT_RUF, OT_RUB, OT_RDF, OT_RDB, OT_LUF, OT_LUB, OT_LDF, OT_LDB}, // RDF
-        {OT_RUF, OT_RUB, OT_RDF, OT_RDB, OT_LUF, OT_LUB, OT_LDF, OT_LDB}, // RUB
-        {OT_RUF, OT_RUB, OT_RDF, OT_RDB, OT_LUF, OT_LUB, OT_LDF, OT_LDB}  // RUF
-    };
+/**
+ * @brief      Constructs a copy of a node without links
+ *
+ * The positions and bounding boxes are allocated with exact size from
+ * the arena. The parent and children are left unset.
+ *
+ * @param[in]  other  node to copy
+ * @param      arena  arena to take the storage from
+ */
+template <class T, unsigned int D>
+OctreeNode<T, D>::OctreeNode(const OctreeNode& other, OctreeArena* arena) :
+    cx(other.cx),
+    cy(other.cy),
+    cz(other.cz),
+    x(other.x),
+    y(other.y),
+    z(other.z),
+    level(other.level),
+    leaf(other.leaf),
+    type(other.type),
+    qbits(other.qbits),
+    pooled(true),
+    objects(other.objects),
+    pos(other.pos.begin(), other.pos.end(), OctreeAllocator<double>(arena)),
+    qpos(other.qpos.begin(), other.qpos.end(), OctreeAllocator<unsigned char>(arena)),
+    boxed(other.boxed),
+    boxes(other.boxes.begin(), other.boxes.end(), OctreeAllocator<double>(arena)) {
 
-    return table[i][o];
-}
-
-/**
- * @brief      determines label of face common to o and neighboring node in direction i
- *
- * @param[in]  i     direction
- * @param[in]  o     octant
- *
- * @return     face label
- */
-template <class T>
-unsigned int OctreeNode<T>::common_face(unsigned int i, unsigned int o) const {
-    static const unsigned int table[20][8] = {
-        {OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_L, OT_D_L, OT_D_D, OT_D_D, OT_D_UNKNOWN, OT_D_UNKNOWN}, // LD
-        {OT_D_L, OT_D_L, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_U, OT_D_U}, // LU
-        {OT_D_UNKNOWN, OT_D_L, OT_D_UNKNOWN, OT_D_L, OT_D_B, OT_D_UNKNOWN, OT_D_B, OT_D_UNKNOWN}, // LB
-        {OT_D_L, OT_D_UNKNOWN, OT_D_L, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_F, OT_D_UNKNOWN, OT_D_F}, // LF
-        {OT_D_D, OT_D_D, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_R, OT_D_R}, // RD
-        {OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_U, OT_D_U, OT_D_R, OT_D_R, OT_D_UNKNOWN, OT_D_UNKNOWN}, // RU
-        {OT_D_B, OT_D_UNKNOWN, OT_D_B, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_R, OT_D_UNKNOWN, OT_D_R}, // RB
-        {OT_D_UNKNOWN, OT_D_F, OT_D_UNKNOWN, OT_D_F, OT_D_R, OT_D_UNKNOWN, OT_D_R, OT_D_UNKNOWN}, // RF
-        {OT_D_UNKNOWN, OT_D_D, OT_D_B, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_D, OT_D_B, OT_D_UNKNOWN}, // DB
-        {OT_D_D, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_F, OT_D_D, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_F}, // DF
-        {OT_D_B, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_U, OT_D_B, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_U}, // UB
-        {OT_D_UNKNOWN, OT_D_F, OT_D_U, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_F, OT_D_U, OT_D_UNKNOWN},  // UF
-        {OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_L, OT_D_UNKNOWN, OT_D_D, OT_D_B, OT_D_UNKNOWN}, // LDB
-        {OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_L, OT_D_UNKNOWN, OT_D_D, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_F}, // LDF
-        {OT_D_UNKNOWN, OT_D_L, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_B, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_U}, // LUB
-        {OT_D_L, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_F, OT_D_U, OT_D_UNKNOWN}, // LUF
-        {OT_D_UNKNOWN, OT_D_D, OT_D_B, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_R}, // RDB
-        {OT_D_D, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_F, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_R, OT_D_UNKNOWN}, // RDF
-        {OT_D_B, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_U, OT_D_UNKNOWN, OT_D_R, OT_D_UNKNOWN, OT_D_UNKNOWN}, // RUB
-        {OT_D_UNKNOWN, OT_D_F, OT_D_U, OT_D_UNKNOWN, OT_D_R, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN}  // RUF
-    };
+    std::copy(other.bmin, other.bmin + 3, this->bmin);
+    std::copy(other.bmax, other.bmax + 3, this->bmax);
+}
 
-    return table[i-6][o];
+/**
+ * @brief      size of the storage of the node in an arena
+ *
+ * @return     size in bytes
+ */
+template <class T, unsigned int D>
+size_t OctreeNode<T, D>::storage_size() const {
+    return OctreeArena::padded(this->pos.size() * sizeof(double)) +
+           OctreeArena::padded(this->qpos.size()) +
+           OctreeArena::padded(this->boxes.size() * sizeof(double));
 }
 
 /**
- * @brief      determines label of edge common to o and neighboring node in
- *             direction i
+ * @brief      destroy a node and its subtree
  *
- * @param[in]  i     direction
- * @param[in]  o     octant
+ * Nodes living in an arena are only destructed; their memory belongs
+ * to the arena.
  *
- * @return     edge label
+ * @param      node  pointer to node (may be nullptr)
  */
-template <class T>
-unsigned int OctreeNode<T>::common_edge(unsigned int i, unsigned int o) const {
-    static const unsigned int table[8][8] = {
-        {OT_D_UNKNOWN, OT_D_LD, OT_D_LB, OT_D_UNKNOWN, OT_D_DB, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN},
-        {OT_D_LD, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_LF, OT_D_UNKNOWN, OT_D_DF, OT_D_UNKNOWN, OT_D_UNKNOWN},
-        {OT_D_LB, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_LU, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UB, OT_D_UNKNOWN},
-        {OT_D_UNKNOWN, OT_D_LF, OT_D_LU, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UF},
-        {OT_D_DB, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_RD, OT_D_RB, OT_D_UNKNOWN},
-        {OT_D_UNKNOWN, OT_D_DF, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_RD, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_RF},
-        {OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UB, OT_D_UNKNOWN, OT_D_RB, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_RU},
-        {OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UNKNOWN, OT_D_UF, OT_D_UNKNOWN, OT_D_RF, OT_D_RU, OT_D_UNKNOWN}
-    };
+template <class T, unsigned int D>
+void OctreeNode<T, D>::destroy(OctreeNode* node) {
+    if(node == nullptr) {
+        return;
+    }
+
+    if(node->pooled) {
+        node->~OctreeNode();
+    } else {
+        delete node;
+    }
+}
+
+/**
+ * @brief      Constructs the iterator
+ *
+ * @param      _top          root of the (sub)tree to traverse
+ * @param[in]  _order        OT_ORDER_PRE or OT_ORDER_POST
+ * @param[in]  _leaves_only  whether to only visit leaves
+ * @param[in]  _level        only visit nodes at this level (-1 for all levels)
+ */
+template <class T, unsigned int D>
+OctreeIterator<T, D>::OctreeIterator(OctreeNode<T, D>* _top, unsigned int _order, bool _leaves_only, int _level) :
+    top(_top),
+    order(_order),
+    leaves_only(_leaves_only),
+    level(_level) {
+
+    if(this->top == nullptr || (this->level >= 0 && (int)this->top->get_level() > this->level)) {
+        return;
+    }
+
+    this->node = (this->order == OT_ORDER_PRE) ? this->top : this->descend_first(this->top);
+
+    while(this->node != nullptr && !this->accept(this->node)) {
+        this->step();
+    }
+}
+
+/**
+ * @brief      advance to the next node
+ *
+ * @return     reference to this iterator
+ */
+template <class T, unsigned int D>
+OctreeIterator<T, D>& OctreeIterator<T, D>::operator++() {
+    do {
+        this->step();
+    } while(this->node != nullptr && !this->accept(this->node));
+
+    return *this;
+}
+
+/**
+ * @brief      whether the traversal does not descend below this node
+ *
+ * @param[in]  n     node
+ *
+ * @return     true if n is a leaf or sits at the level filter
+ */
+template <class T, unsigned int D>
+bool OctreeIterator<T, D>::is_terminal(const OctreeNode<T, D>* n) const {
+    return n->is_leaf() || (int)n->get_level() == this->level;
+}
+
+/**
+ * @brief      whether node passes the leaf and level filters
+ *
+ * @param[in]  n     node
+ *
+ * @return     true if node is visited
+ */
+template <class T, unsigned int D>
+bool OctreeIterator<T, D>::accept(const OctreeNode<T, D>* n) const {
+    if(this->leaves_only && !n->is_leaf()) {
+        return false;
+    }
+
+    return this->level < 0 || (int)n->get_level() == this->level;
+}
+
+/**
+ * @brief      get first terminal node below n following the first octants
+ *
+ * @param      n     node
+ *
+ * @return     pointer to node
+ */
+template <class T, unsigned int D>
+OctreeNode<T, D>* OctreeIterator<T, D>::descend_first(OctreeNode<T, D>* n) const {
+    while(!this->is_terminal(n)) {
+        n = n->get_child(0);
+    }
+
+    return n;
+}
+
+/**
+ * @brief      move to the next node in traversal order without filtering
+ */
+template <class T, unsigned int D>
+void OctreeIterator<T, D>::step() {
+    if(this->order == OT_ORDER_PRE) {
+        if(!this->is_terminal(this->node)) {
+            this->node = this->node->get_child(0);
+            return;
+        }
 
-    return table[i-18][o];
+        // climb until a node is found that has a next sibling
+        while(this->node != this->top) {
+            const unsigned int type = this->node->get_type();
+            if(type + 1 < OctreeNode<T, D>::nr_children) {
+                this->node = this->node->get_parent()->get_child(type + 1);
+                return;
+            }
+            this->node = this->node->get_parent();
+        }
+
+        this->node = nullptr;
+    } else {
+        if(this->node == this->top) {
+            this->node = nullptr;
+            return;
+        }
+
+        // move to the next sibling subtree or finish the parent
+        const unsigned int type = this->node->get_type();
+        if(type + 1 < OctreeNode<T, D>::nr_children) {
+            this->node = this->descend_first(this->node->get_parent()->get_child(type + 1));
+        } else {
+            this->node = this->node->get_parent();
+        }
+    }
 }
 
 #endif // _OCTREE_IMPL
@@ -30,7 +30,21 @@
 
 #include <vector>
 #include <iostream>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <functional>
 #include <unordered_set>
+#include <unordered_map>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <stdexcept>
+#include <memory>
+#include <type_traits>
 
 #include "octreetypes.h"
 
@@ -42,12 +56,169 @@
  *    DOI: https://doi.org/10.1016/0734-189X(89)90038-8
  */
 
+/**
+ * @brief      Contiguous buffer for relocated nodes and their storage
+ *
+ * The buffer is handed out front to back while it is open. Memory taken
+ * from it is released as a whole when the arena is destroyed.
+ */
+class OctreeArena {
+
+private:
+    char* begin;    //!< start of the buffer
+    char* end;      //!< end of the buffer
+    char* next;     //!< start of the free part of the buffer
+
+public:
+    /**
+     * @brief      Constructs the object.
+     *
+     * @param[in]  size  size of the buffer in bytes
+     */
+    OctreeArena(size_t size) :
+        begin(static_cast<char*>(::operator new(size))),
+        end(begin + size),
+        next(begin) {}
+
+    OctreeArena(const OctreeArena&) = delete;
+    OctreeArena& operator=(const OctreeArena&) = delete;
+
+    /**
+     * @brief      Destroys the object.
+     */
+    ~OctreeArena() {
+        ::operator delete(this->begin);
+    }
+
+    /**
+     * @brief      size of a block in the buffer, keeping blocks 8 byte aligned
+     *
+     * @param[in]  size  requested size in bytes
+     *
+     * @return     size of the block in bytes
+     */
+    static inline size_t padded(size_t size) {
+        return (size + 7) & ~(size_t)7;
+    }
+
+    /**
+     * @brief      take a block from the free part of the buffer
+     *
+     * @param[in]  size  size in bytes
+     *
+     * @return     pointer to the block (nullptr if it does not fit or the
+     *             arena is closed)
+     */
+    inline void* take(size_t size) {
+        size = padded(size);
+        if(size > (size_t)(this->end - this->next)) {
+            return nullptr;
+        }
+
+        void* p = this->next;
+        this->next += size;
+        return p;
+    }
+
+    /**
+     * @brief      stop handing out memory
+     */
+    inline void close() {
+        this->next = this->end;
+    }
+
+    /**
+     * @brief      whether memory lies in the buffer
+     *
+     * @param[in]  p     pointer to memory
+     *
+     * @return     true if the memory belongs to the arena
+     */
+    inline bool owns(const void* p) const {
+        return p >= static_cast<const void*>(this->begin) && p < static_cast<const void*>(this->end);
+    }
+};
+
+/**
+ * @brief      Allocator for the storage of a node
+ *
+ * Takes memory from an open arena if one is set and from the heap
+ * otherwise. Memory belonging to the arena is not freed individually.
+ *
+ * @tparam     U     value type
+ */
+template <class U>
+class OctreeAllocator {
+
+public:
+    typedef U value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    OctreeArena* arena = nullptr;   //!< arena to take memory from (nullptr for the heap)
+
+    OctreeAllocator() {}
+
+    /**
+     * @brief      Constructs the object.
+     *
+     * @param      _arena  arena to take memory from
+     */
+    OctreeAllocator(OctreeArena* _arena) : arena(_arena) {}
+
+    template <class V>
+    OctreeAllocator(const OctreeAllocator<V>& other) : arena(other.arena) {}
+
+    /**
+     * @brief      allocate memory for n values
+     *
+     * @param[in]  n     number of values
+     *
+     * @return     pointer to memory
+     */
+    U* allocate(size_t n) {
+        if(this->arena != nullptr) {
+            void* p = this->arena->take(n * sizeof(U));
+            if(p != nullptr) {
+                return static_cast<U*>(p);
+            }
+        }
+        return static_cast<U*>(::operator new(n * sizeof(U)));
+    }
+
+    /**
+     * @brief      release memory
+     *
+     * @param      p     pointer to memory
+     */
+    void deallocate(U* p, size_t) {
+        if(this->arena != nullptr && this->arena->owns(p)) {
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    template <class V>
+    bool operator==(const OctreeAllocator<V>& other) const {
+        return this->arena == other.arena;
+    }
+
+    template <class V>
+    bool operator!=(const OctreeAllocator<V>& other) const {
+        return this->arena != other.arena;
+    }
+};
+
 /**
  * @brief      Class for octree node.
  *
+ * For D = 2 the node is a quadtree node: the cells are only subdivided
+ * along x and y, and the z extent of every cell is that of the root.
+ *
  * @tparam     T     object class
+ * @tparam     D     dimension (3 for an octree, 2 for a quadtree)
  */
-template <class T>
+template <class T, unsigned int D = 3>
 class OctreeNode {
 
 private:
@@ -59,16 +230,33 @@ private:
     double y;       //!< breadth of the cell
     double z;       //!< height of the cell
 
-    std::vector<T*> objects;    //!< vector of pointers to objects
-    std::vector<double> pos;    //!< positions of the objects
+    // the fields above and below are read on every step of a descent and are
+    // kept together at the start of the node
 
     OctreeNode* parent = nullptr;   //!< pointer to parent
-    OctreeNode* children[8] = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr}; //!< pointer to children
+    OctreeNode* children[OctreeTables<D>::nr_children] = {};  //!< pointer to children
 
     unsigned int level;     //!< level of the node
     bool leaf = true;       //!< whether node is a leaf
+    unsigned char type = OT_ROOT;   //!< octant type of the node
+    unsigned char qbits = 0;    //!< bits per quantized coordinate (0 for full precision)
+    bool pooled = false;        //!< whether the node lives in an arena
+
+    double bmin[3];     //!< lower corner of the bounding box of the contents
+    double bmax[3];     //!< upper corner of the bounding box of the contents
+
+    std::vector<T*> objects;    //!< vector of pointers to objects
+    std::vector<double, OctreeAllocator<double>> pos;   //!< positions of the objects
+    std::vector<unsigned char, OctreeAllocator<unsigned char>> qpos;    //!< quantized positions of the objects (compact mode)
+
+    std::vector<T*> boxed;      //!< vector of pointers to objects with a bounding box
+    std::vector<double, OctreeAllocator<double>> boxes; //!< bounding boxes of these objects (lower and upper corner)
 
 public:
+    static constexpr unsigned int nr_children = OctreeTables<D>::nr_children;      //!< number of children
+    static constexpr unsigned int nr_directions = OctreeTables<D>::nr_directions;  //!< number of face, edge and vertex directions
+    static constexpr unsigned int max_level = 21;   //!< deepest level at which full leaves are split
+
     /**
      * @brief      Constructs the object.
      *
@@ -87,9 +275,22 @@ public:
                unsigned int _level);
 
     /**
-     * @brief      split the cell into 8 octants
+     * @brief      split the cell into 8 octants (4 quadrants in 2-D)
+     *
+     * Only this subtree is modified, such that distinct leaves can be
+     * split concurrently.
+     *
+     * @param[in]  loose  looseness factor of the tree (0 to keep the objects
+     *                    with a bounding box in this node)
+     */
+    void split(double loose = 0.0);
+
+    /**
+     * @brief      merge the children into this node
+     *
+     * All children should be leaves. Only this subtree is modified.
      */
-    void split();
+    void merge();
 
     /**
      * @brief      add object to node
@@ -98,8 +299,105 @@ public:
      * @param[in]  _px     object position x
      * @param[in]  _py     object position y
      * @param[in]  _pz     object position z
+     * @param[in]  loose   looseness factor of the tree (0 to keep the objects
+     *                     with a bounding box in this node upon a split)
      */
-    void add(T* object, double _px, double _py, double _pz);
+    void add(T* object, double _px, double _py, double _pz, double loose = 0.0);
+
+    /**
+     * @brief      add object with a bounding box to node
+     *
+     * The box should lie within the loose box of the node.
+     *
+     * @param      object  pointer to object
+     * @param[in]  _bmin   lower corner of the bounding box
+     * @param[in]  _bmax   upper corner of the bounding box
+     * @param[in]  loose   looseness factor of the tree
+     */
+    void add(T* object, const double _bmin[3], const double _bmax[3], double loose);
+
+    /**
+     * @brief      get position of an object
+     *
+     * In compact mode, the position is decoded from the quantized offset
+     * with respect to the cell.
+     *
+     * @param[in]  i     index of the object
+     * @param[out] _px   object position x
+     * @param[out] _py   object position y
+     * @param[out] _pz   object position z
+     */
+    void get_position(unsigned int i, double* _px, double* _py, double* _pz) const;
+
+    /**
+     * @brief      recalculate the bounding box of the contents
+     *
+     * Uses the positions of the objects for a leaf and the bounding boxes
+     * of the children otherwise; the latter should be up to date.
+     */
+    void update_bounds();
+
+    /**
+     * @brief      expand the bounding box of this node and its ancestors
+     *
+     * @param[in]  _px   position x
+     * @param[in]  _py   position y
+     * @param[in]  _pz   position z
+     */
+    void expand_bounds(double _px, double _py, double _pz);
+
+    /**
+     * @brief      squared distance from a position to the bounding box of
+     *             the contents
+     *
+     * @param[in]  _px   position x
+     * @param[in]  _py   position y
+     * @param[in]  _pz   position z
+     *
+     * @return     squared distance (infinity if the node holds no objects)
+     */
+    double bounds_distance2(double _px, double _py, double _pz) const;
+
+    /**
+     * @brief      squared distance between the bounding boxes of the
+     *             contents of two nodes
+     *
+     * @param[in]  other  pointer to other node
+     *
+     * @return     squared distance (infinity if either node holds no objects)
+     */
+    double bounds_distance2(const OctreeNode* other) const;
+
+    /**
+     * @brief      whether a box overlaps the bounding box of the contents
+     *
+     * @param[in]  _bmin  lower corner of the box
+     * @param[in]  _bmax  upper corner of the box
+     *
+     * @return     true if the boxes overlap (false if the node holds no objects)
+     */
+    bool bounds_overlap(const double _bmin[3], const double _bmax[3]) const;
+
+    /**
+     * @brief      whether a box lies within the loose box of the cell
+     *
+     * The loose box shares its center with the cell and is larger by the
+     * looseness factor.
+     *
+     * @param[in]  _bmin  lower corner of the box
+     * @param[in]  _bmax  upper corner of the box
+     * @param[in]  loose  looseness factor of the tree
+     *
+     * @return     true if the box is contained
+     */
+    bool loose_contains(const double _bmin[3], const double _bmax[3], double loose) const;
+
+    /**
+     * @brief      change the storage of the positions in this node
+     *
+     * @param[in]  bits  bits per coordinate (16 or 21), 0 for full precision
+     */
+    void set_qbits(unsigned int bits);
 
     /**
      * @brief      get child node given octant position
@@ -126,7 +424,32 @@ public:
      *
      * @return     octant type
      */
-    unsigned int get_type() const;
+    inline unsigned int get_type() const {
+        return this->type;
+    }
+
+    /**
+     * @brief      get the octant that contains a position
+     *
+     * @param[in]  _px   position x
+     * @param[in]  _py   position y
+     * @param[in]  _pz   position z
+     *
+     * @return     octant label
+     */
+    inline unsigned int get_octant(double _px, double _py, double _pz) const {
+        return ((_px < this->cx ? 0u : 1u) << (D - 1)) | (D == 3 && _pz >= this->cz ? 2u : 0u) | (_py < this->cy ? 0u : 1u);
+    }
+
+    /**
+     * @brief      prefetch the fields of the node read during a descent
+     */
+    inline void prefetch() const {
+#if defined(__GNUC__)
+        __builtin_prefetch(this);
+        __builtin_prefetch(reinterpret_cast<const char*>(&this->children[nr_children - 1]));
+#endif
+    }
 
     /**
      * @brief      find node given position
@@ -146,6 +469,19 @@ public:
      */
     std::vector<OctreeNode*> find_neighbors() const;
 
+    /**
+     * @brief      find neighbor (equal or larger in size) in direction i
+     *
+     * Ascends while the node lies on the side of its parent along any axis
+     * of the direction, continuing with the direction restricted to those
+     * axes, and descends along the reflected octants.
+     *
+     * @param[in]  i     direction i (face, edge or vertex direction)
+     *
+     * @return     pointer to neighbor
+     */
+    OctreeNode* find_gteq_neighbor(unsigned int i) const;
+
     /**
      * @brief      find face neighbor (equal or larger in size) in direction i
      *
@@ -153,16 +489,22 @@ public:
      *
      * @return     pointer to face neighbor
      */
-    OctreeNode* find_gteq_neighbor_face(unsigned int i) const;
+    inline OctreeNode* find_gteq_neighbor_face(unsigned int i) const {
+        return this->find_gteq_neighbor(i);
+    }
 
     /**
      * @brief      find edge neighbor (equal or larger in size) in direction i
      *
+     * In 2-D, the edge directions are the corners of the cell.
+     *
      * @param[in]  i     direction i
      *
      * @return     pointer to edge neighbor
      */
-    OctreeNode* find_gteq_neighbor_edge(unsigned int i) const;
+    inline OctreeNode* find_gteq_neighbor_edge(unsigned int i) const {
+        return this->find_gteq_neighbor(i);
+    }
 
     /**
      * @brief      find vertex neighbor (equal or larger in size) in direction i
@@ -171,7 +513,18 @@ public:
      *
      * @return     pointer to vertex neighbor
      */
-    OctreeNode* find_gteq_neighbor_vertex(unsigned int i) const;
+    inline OctreeNode* find_gteq_neighbor_vertex(unsigned int i) const {
+        return this->find_gteq_neighbor(i);
+    }
+
+    /**
+     * @brief      whether node shares a face, edge or vertex with another node
+     *
+     * @param[in]  other  pointer to other node
+     *
+     * @return     true if the cells touch or overlap, false otherwise
+     */
+    bool touches(const OctreeNode* other) const;
 
     /**
      * @brief      print the tree
@@ -212,6 +565,69 @@ public:
         return this->cz;
     }
 
+    /**
+     * @brief      get width of the cell
+     *
+     * @return     width of the cell
+     */
+    inline double get_x() const {
+        return this->x;
+    }
+
+    /**
+     * @brief      get breadth of the cell
+     *
+     * @return     breadth of the cell
+     */
+    inline double get_y() const {
+        return this->y;
+    }
+
+    /**
+     * @brief      get height of the cell
+     *
+     * @return     height of the cell
+     */
+    inline double get_z() const {
+        return this->z;
+    }
+
+    /**
+     * @brief      get lower corner of the bounding box of the contents
+     *
+     * @return     pointer to x, y and z of the lower corner
+     */
+    inline const double* get_bounds_min() const {
+        return this->bmin;
+    }
+
+    /**
+     * @brief      get upper corner of the bounding box of the contents
+     *
+     * @return     pointer to x, y and z of the upper corner
+     */
+    inline const double* get_bounds_max() const {
+        return this->bmax;
+    }
+
+    /**
+     * @brief      whether the node or its descendants hold any objects
+     *
+     * @return     true if the bounding box of the contents is empty
+     */
+    inline bool is_empty() const {
+        return this->bmin[0] > this->bmax[0];
+    }
+
+    /**
+     * @brief      get node level
+     *
+     * @return     level of the node (root is at level 0)
+     */
+    inline unsigned int get_level() const {
+        return this->level;
+    }
+
     /**
      * @brief      determines if node is leaf
      *
@@ -230,6 +646,26 @@ public:
         return this->objects;
     }
 
+    /**
+     * @brief      get the objects with a bounding box of the node
+     *
+     * @return     vector of pointer to objects
+     */
+    inline const std::vector<T*>& get_boxed() const {
+        return this->boxed;
+    }
+
+    /**
+     * @brief      get the bounding box of an object with a bounding box
+     *
+     * @param[in]  i     index of the object
+     *
+     * @return     pointer to the lower corner, followed by the upper corner
+     */
+    inline const double* get_box(unsigned int i) const {
+        return &this->boxes[i*6];
+    }
+
 private:
 
     /***********************************************************
@@ -246,7 +682,9 @@ private:
      *
      * @return     true if adjacent, false otherwise
      */
-    bool adj(unsigned int i, unsigned int o) const;
+    inline bool adj(unsigned int i, unsigned int o) const {
+        return octree_tables<D>.adj[i][o];
+    }
 
     /**
      * @brief      determines neighboring octant label in direction i
@@ -256,71 +694,530 @@ private:
      *
      * @return     octant label
      */
-    unsigned int reflect(unsigned int i, unsigned int o) const;
+    inline unsigned int reflect(unsigned int i, unsigned int o) const {
+        return octree_tables<D>.reflect[i][o];
+    }
 
     /**
-     * @brief      determines label of face common to o and neighboring node in direction i
+     * @brief      determines the direction in which the parent of octant o
+     *             shares the neighbor in direction i
+     *
+     * This is the face (or edge) common to o and the neighboring node for
+     * an edge (or vertex) direction, direction i itself if o is adjacent
+     * to it and nr_directions if the neighbor is a sibling.
      *
      * @param[in]  i     direction
      * @param[in]  o     octant
      *
-     * @return     face label
+     * @return     direction label
      */
-    unsigned int common_face(unsigned int i, unsigned int o) const;
+    inline unsigned int common(unsigned int i, unsigned int o) const {
+        return octree_tables<D>.common[i][o];
+    }
 
     /**
-     * @brief      determines label of edge common to o and neighboring node in
-     *             direction i
+     * @brief      expand the bounding box of this node only
      *
-     * @param[in]  i     direction
-     * @param[in]  o     octant
+     * @param[in]  _px   position x
+     * @param[in]  _py   position y
+     * @param[in]  _pz   position z
      *
-     * @return     edge label
+     * @return     true if the bounding box has grown
      */
-    unsigned int common_edge(unsigned int i, unsigned int o) const;
-};
+    bool grow_bounds(double _px, double _py, double _pz);
 
-/**
- * @brief      Class for octree.
- *
- * @tparam     T     object type
- */
-template <class T>
-class Octree {
-
-private:
-    OctreeNode<T>* root = nullptr;  //!< pointer to root node
-
-    double cx;                      //!< octree center x
-    double cy;                      //!< octree center y
-    double cz;                      //!< octree center z
-
-    double x;                       //!< octree widht
-    double y;                       //!< octree breadth
-    double z;                       //!< octree height
-
-public:
     /**
-     * @brief      Octree constructor
+     * @brief      append object to the storage of this node
      *
-     * @param[in]  _px     width of principal cell
-     * @param[in]  _py     breadth of principal cell
-     * @param[in]  _pz     height of principal cell
+     * Only the bounding box of this node is updated.
      *
+     * @param      object  pointer to object
+     * @param[in]  _px     object position x
+     * @param[in]  _py     object position y
+     * @param[in]  _pz     object position z
      */
-    Octree(double _x, double _y, double _z);
+    void store(T* object, double _px, double _py, double _pz);
 
-    /**
-     * @brief      add object to the tree
+    /***********************************************************
      *
-     * @param      object  pointer to object
-     * @param[in]  _px     x position
+     * POSITION COMPRESSION
+     *
+     ***********************************************************/
+
+    /**
+     * @brief      append object to the storage of this node given its
+     *             quantized position
+     *
+     * Only the bounding box of this node is updated.
+     *
+     * @param      object  pointer to object
+     * @param[in]  q       quantized position
+     */
+    void store_quantized(T* object, const uint32_t q[3]);
+
+    /**
+     * @brief      append object with a bounding box to the storage of this
+     *             node
+     *
+     * Only the bounding box of this node is updated.
+     *
+     * @param      object  pointer to object
+     * @param[in]  _bmin   lower corner of the bounding box
+     * @param[in]  _bmax   upper corner of the bounding box
+     */
+    void store_box(T* object, const double _bmin[3], const double _bmax[3]);
+
+    /**
+     * @brief      number of objects held by the node itself
+     *
+     * @return     number of objects with a position or a bounding box
+     */
+    inline size_t count() const {
+        return this->objects.size() + this->boxed.size();
+    }
+
+    /**
+     * @brief      quantize coordinate on the grid of the cell
+     *
+     * @param[in]  p     coordinate
+     * @param[in]  c     center of the cell
+     * @param[in]  l     length of the cell
+     *
+     * @return     quantized coordinate
+     */
+    uint32_t quantize(double p, double c, double l) const;
+
+    /**
+     * @brief      append quantized position to storage
+     *
+     * @param[in]  q     quantized position
+     */
+    void push_quantized(const uint32_t q[3]);
+
+    /**
+     * @brief      read quantized position from storage
+     *
+     * @param[in]  i     index of the object
+     * @param[out] q     quantized position
+     */
+    void get_quantized(unsigned int i, uint32_t q[3]) const;
+
+    /**
+     * @brief      number of bytes per quantized position
+     *
+     * @return     6 for 16 bit coordinates, 8 for 21 bit coordinates
+     */
+    inline unsigned int qstride() const {
+        return this->qbits == 16 ? 6 : 8;
+    }
+
+    /***********************************************************
+     *
+     * RELOCATION
+     *
+     ***********************************************************/
+
+    /**
+     * @brief      Constructs a copy of a node without links
+     *
+     * The positions and bounding boxes are allocated with exact size from
+     * the arena. The parent and children are left unset.
+     *
+     * @param[in]  other  node to copy
+     * @param      arena  arena to take the storage from
+     */
+    OctreeNode(const OctreeNode& other, OctreeArena* arena);
+
+    /**
+     * @brief      size of the storage of the node in an arena
+     *
+     * @return     size in bytes
+     */
+    size_t storage_size() const;
+
+    /**
+     * @brief      destroy a node and its subtree
+     *
+     * Nodes living in an arena are only destructed; their memory belongs
+     * to the arena.
+     *
+     * @param      node  pointer to node (may be nullptr)
+     */
+    static void destroy(OctreeNode* node);
+
+    template <class U, unsigned int E> friend class Octree;
+};
+
+/**
+ * @brief      Forward iterator over the nodes of a (sub)tree
+ *
+ * Nodes are visited in Morton order (the order of the octant labels) without
+ * recursion: the iterator steps through the tree using the parent pointers
+ * and the octant type of the current node, so it only stores the node it
+ * is on.
+ *
+ * @tparam     T     object class
+ * @tparam     D     dimension
+ */
+template <class T, unsigned int D = 3>
+class OctreeIterator {
+
+private:
+    OctreeNode<T, D>* node = nullptr;  //!< current node (nullptr when exhausted)
+    OctreeNode<T, D>* top = nullptr;   //!< root of the traversed (sub)tree
+
+    unsigned int order = OT_ORDER_PRE;  //!< pre-order or post-order traversal
+    bool leaves_only = false;           //!< whether to only visit leaves
+    int level = -1;                     //!< only visit nodes at this level (-1 for all levels)
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = OctreeNode<T, D>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = OctreeNode<T, D>*;
+    using reference = OctreeNode<T, D>&;
+
+    /**
+     * @brief      Constructs the end iterator
+     */
+    OctreeIterator() {}
+
+    /**
+     * @brief      Constructs the iterator
+     *
+     * @param      _top          root of the (sub)tree to traverse
+     * @param[in]  _order        OT_ORDER_PRE or OT_ORDER_POST
+     * @param[in]  _leaves_only  whether to only visit leaves
+     * @param[in]  _level        only visit nodes at this level (-1 for all levels)
+     */
+    OctreeIterator(OctreeNode<T, D>* _top, unsigned int _order, bool _leaves_only, int _level);
+
+    /**
+     * @brief      get current node
+     *
+     * @return     reference to current node
+     */
+    inline reference operator*() const {
+        return *this->node;
+    }
+
+    /**
+     * @brief      get current node
+     *
+     * @return     pointer to current node
+     */
+    inline pointer operator->() const {
+        return this->node;
+    }
+
+    /**
+     * @brief      advance to the next node
+     *
+     * @return     reference to this iterator
+     */
+    OctreeIterator& operator++();
+
+    /**
+     * @brief      advance to the next node
+     *
+     * @return     copy of the iterator before advancing
+     */
+    inline OctreeIterator operator++(int) {
+        OctreeIterator tmp = *this;
+        ++(*this);
+        return tmp;
+    }
+
+    inline bool operator==(const OctreeIterator& other) const {
+        return this->node == other.node;
+    }
+
+    inline bool operator!=(const OctreeIterator& other) const {
+        return this->node != other.node;
+    }
+
+private:
+    /**
+     * @brief      whether the traversal does not descend below this node
+     *
+     * @param[in]  n     node
+     *
+     * @return     true if n is a leaf or sits at the level filter
+     */
+    bool is_terminal(const OctreeNode<T, D>* n) const;
+
+    /**
+     * @brief      whether node passes the leaf and level filters
+     *
+     * @param[in]  n     node
+     *
+     * @return     true if node is visited
+     */
+    bool accept(const OctreeNode<T, D>* n) const;
+
+    /**
+     * @brief      get first terminal node below n following the first octants
+     *
+     * @param      n     node
+     *
+     * @return     pointer to node
+     */
+    OctreeNode<T, D>* descend_first(OctreeNode<T, D>* n) const;
+
+    /**
+     * @brief      move to the next node in traversal order without filtering
+     */
+    void step();
+};
+
+/**
+ * @brief      Range of nodes that can be used in range-based for loops and
+ *             standard algorithms
+ *
+ * @tparam     T     object class
+ * @tparam     D     dimension
+ */
+template <class T, unsigned int D = 3>
+class OctreeRange {
+
+private:
+    OctreeIterator<T, D> first;    //!< iterator to first node
+    OctreeIterator<T, D> last;     //!< past-the-end iterator
+
+public:
+    /**
+     * @brief      Constructs the range over a (sub)tree
+     *
+     * @param      _top          root of the (sub)tree
+     * @param[in]  _order        OT_ORDER_PRE or OT_ORDER_POST
+     * @param[in]  _leaves_only  whether to only visit leaves
+     * @param[in]  _level        only visit nodes at this level (-1 for all levels)
+     */
+    OctreeRange(OctreeNode<T, D>* _top, unsigned int _order, bool _leaves_only, int _level) :
+        first(_top, _order, _leaves_only, _level) {}
+
+    /**
+     * @brief      Constructs the range from two iterators
+     *
+     * @param[in]  _first  iterator to first node
+     * @param[in]  _last   past-the-end iterator
+     */
+    OctreeRange(const OctreeIterator<T, D>& _first, const OctreeIterator<T, D>& _last) :
+        first(_first),
+        last(_last) {}
+
+    inline OctreeIterator<T, D> begin() const {
+        return this->first;
+    }
+
+    inline OctreeIterator<T, D> end() const {
+        return this->last;
+    }
+};
+
+/**
+ * @brief      Contiguous chunk of leaves produced by Octree::partition
+ *
+ * The chunk is a view on the tree, so no nodes are copied. The halo holds
+ * the leaves of other chunks that are adjacent to the leaves of this chunk.
+ *
+ * @tparam     T     object class
+ * @tparam     D     dimension
+ */
+template <class T, unsigned int D = 3>
+class OctreePartition {
+
+private:
+    OctreeRange<T, D> leaves;              //!< leaves of the chunk in Morton order
+    size_t size;                        //!< number of leaves in the chunk
+    double weight;                      //!< accumulated weight of the leaves
+    std::vector<OctreeNode<T, D>*> halo;   //!< adjacent leaves of other chunks
+
+public:
+    /**
+     * @brief      Constructs the object.
+     *
+     * @param[in]  _leaves  leaves of the chunk
+     * @param[in]  _size    number of leaves in the chunk
+     * @param[in]  _weight  accumulated weight of the leaves
+     */
+    OctreePartition(const OctreeRange<T, D>& _leaves, size_t _size, double _weight) :
+        leaves(_leaves),
+        size(_size),
+        weight(_weight) {}
+
+    /**
+     * @brief      get the leaves of the chunk
+     *
+     * @return     range of leaves in Morton order
+     */
+    inline const OctreeRange<T, D>& get_leaves() const {
+        return this->leaves;
+    }
+
+    /**
+     * @brief      get the number of leaves in the chunk
+     *
+     * @return     number of leaves
+     */
+    inline size_t get_size() const {
+        return this->size;
+    }
+
+    /**
+     * @brief      get the accumulated weight of the chunk
+     *
+     * @return     weight
+     */
+    inline double get_weight() const {
+        return this->weight;
+    }
+
+    /**
+     * @brief      get the halo of the chunk
+     *
+     * @return     leaves of other chunks adjacent to this chunk, in Morton order
+     */
+    inline const std::vector<OctreeNode<T, D>*>& get_halo() const {
+        return this->halo;
+    }
+
+    template <class U, unsigned int E> friend class Octree;
+};
+
+/**
+ * @brief      Class for octree.
+ *
+ * @tparam     T     object type
+ * @tparam     D     dimension (3 for an octree, 2 for a quadtree)
+ */
+template <class T, unsigned int D = 3>
+class Octree {
+
+private:
+    static constexpr unsigned int nr_children = OctreeTables<D>::nr_children;  //!< number of children of a node
+
+    OctreeNode<T, D>* root = nullptr;  //!< pointer to root node
+    std::vector<std::unique_ptr<OctreeArena>> arenas;   //!< buffers holding relocated nodes
+
+    double cx;                      //!< octree center x
+    double cy;                      //!< octree center y
+    double cz;                      //!< octree center z
+
+    double x;                       //!< octree widht
+    double y;                       //!< octree breadth
+    double z;                       //!< octree height
+
+    double qerror = 0.0;            //!< error bound per coordinate of the stored positions
+    double loose = 2.0;             //!< looseness factor of the cells for objects with a bounding box
+
+public:
+    /**
+     * @brief      Octree constructor
+     *
+     * @param[in]  _px     width of principal cell
+     * @param[in]  _py     breadth of principal cell
+     * @param[in]  _pz     height of principal cell
+     *
+     */
+    Octree(double _x, double _y, double _z);
+
+    /**
+     * @brief      Octree constructor
+     *
+     * @param[in]  _cx    center x of principal cell
+     * @param[in]  _cy    center y of principal cell
+     * @param[in]  _cz    center z of principal cell
+     * @param[in]  _x     width of principal cell
+     * @param[in]  _y     breadth of principal cell
+     * @param[in]  _z     height of principal cell
+     */
+    Octree(double _cx, double _cy, double _cz, double _x, double _y, double _z);
+
+    Octree(const Octree&) = delete;
+    Octree& operator=(const Octree&) = delete;
+
+    /**
+     * @brief      Octree destructor
+     */
+    ~Octree();
+
+    /**
+     * @brief      add object to the tree
+     *
+     * @param      object  pointer to object
+     * @param[in]  _px     x position
      * @param[in]  _py     y position
      * @param[in]  _pz     z position
      *
      */
     void add(T* object, double _px, double _py, double _pz);
 
+    /**
+     * @brief      add an array of objects to the tree
+     *
+     * The batch is partitioned in place by octant at every node and large
+     * partitions are inserted in parallel. A leaf receiving more objects
+     * than it can hold is split once per level, down to the maximum level.
+     *
+     * @param      objects  pointers to the objects
+     * @param[in]  xyz      positions (x, y and z for every object)
+     * @param[in]  n        number of objects
+     */
+    void add_many(T* const* objects, const double* xyz, size_t n);
+
+    /**
+     * @brief      add object with a bounding box to the tree
+     *
+     * The object is stored at the deepest node whose loose box contains
+     * its bounding box; this may be an internal node. Such objects are
+     * found with find_overlapping and for_each_overlapping_pair.
+     *
+     * @param      object  pointer to object
+     * @param[in]  _bmin   lower corner of the bounding box
+     * @param[in]  _bmax   upper corner of the bounding box
+     */
+    void add(T* object, const double _bmin[3], const double _bmax[3]);
+
+    /**
+     * @brief      set the looseness factor of the cells
+     *
+     * The loose box of a cell shares its center with the cell and is
+     * larger by this factor (2 by default). Objects with a bounding box
+     * that are already in the tree are redistributed.
+     *
+     * @param[in]  k     looseness factor (at least 1)
+     */
+    void set_looseness(double k);
+
+    /**
+     * @brief      move all objects of another tree into this tree
+     *
+     * Both trees are walked together. Subtrees present in only one tree
+     * are moved over without copying; where a leaf meets a leaf or a
+     * subtree, the objects of the leaf are added to the other side. The
+     * other tree is left empty.
+     *
+     * The positions of the other tree are stored with the precision of this
+     * tree; the error bound of the result is the larger of the two bounds.
+     *
+     * @param      other  tree with the same principal cell
+     */
+    void merge(Octree<T, D>&& other);
+
+    /**
+     * @brief      relocate all nodes and their storage into one buffer
+     *
+     * The nodes are placed in breadth-first order (OT_LAYOUT_BFS), in
+     * depth-first Morton order (OT_LAYOUT_DFS) or in van Emde Boas order
+     * (OT_LAYOUT_VEB), followed by the positions and bounding boxes of the
+     * objects in the same order. The storage is sized exactly. The object
+     * pointers and objects added afterwards are stored on the heap.
+     *
+     * @param[in]  layout  order of the nodes
+     */
+    void compact(unsigned int layout = OT_LAYOUT_DFS);
+
     /**
      * @brief      print the tree to std::cout
      */
@@ -337,9 +1234,324 @@ public:
      *
      * @return     pointer to node
      */
-    inline OctreeNode<T>* find_node(double _px, double _py, double _pz) {
+    inline OctreeNode<T, D>* find_node(double _px, double _py, double _pz) {
         return this->root->find_node(_px, _py, _pz);
     }
+
+    /**
+     * @brief      get all nodes of the tree
+     *
+     * @param[in]  order  OT_ORDER_PRE or OT_ORDER_POST
+     * @param[in]  level  only visit nodes at this level (-1 for all levels)
+     *
+     * @return     range of nodes in Morton order
+     */
+    inline OctreeRange<T, D> nodes(unsigned int order = OT_ORDER_PRE, int level = -1) {
+        return OctreeRange<T, D>(this->root, order, false, level);
+    }
+
+    /**
+     * @brief      get all leaves of the tree
+     *
+     * @param[in]  level  only visit leaves at this level (-1 for all levels)
+     *
+     * @return     range of leaves in Morton order
+     */
+    inline OctreeRange<T, D> leaves(int level = -1) {
+        return OctreeRange<T, D>(this->root, OT_ORDER_PRE, true, level);
+    }
+
+    /**
+     * @brief      store positions as fixed-point offsets inside the leaf cells
+     *
+     * The error of positions that have been stored lossily is kept when
+     * switching to a finer precision.
+     *
+     * @param[in]  tolerance  maximum error per coordinate (0 for full precision)
+     *
+     * @return     guaranteed error bound per coordinate (0 if no position
+     *             has been stored lossily)
+     */
+    double set_position_compression(double tolerance);
+
+    /**
+     * @brief      get the error bound of the stored positions
+     *
+     * @return     error bound per coordinate (0 if no position has been
+     *             stored lossily)
+     */
+    inline double get_position_error() const {
+        return this->qerror;
+    }
+
+    /**
+     * @brief      find all objects within a distance from a position
+     *
+     * @param[in]  _px   x position
+     * @param[in]  _py   y position
+     * @param[in]  _pz   z position
+     * @param[in]  r     radius
+     *
+     * @return     vector of pointers to objects
+     */
+    std::vector<T*> find_within_radius(double _px, double _py, double _pz, double r) const;
+
+    /**
+     * @brief      find the leaves for a batch of positions
+     *
+     * @param[in]  xyz    positions (x, y and z for every position)
+     * @param[in]  n      number of positions
+     * @param[out] out    pointers to the leaves
+     * @param[in]  group  number of lookups in flight
+     */
+    void find_nodes(const double* xyz, size_t n, OctreeNode<T, D>** out, unsigned int group = 16) const;
+
+    /**
+     * @brief      find neighbors (equal or larger in size) in direction i for
+     *             a batch of nodes
+     *
+     * @param[in]  nodes  nodes
+     * @param[in]  n      number of nodes
+     * @param[in]  i      direction i (face, edge or vertex direction)
+     * @param[out] out    pointers to the neighbors
+     * @param[in]  group  number of lookups in flight
+     */
+    void find_gteq_neighbors(OctreeNode<T, D>* const* nodes, size_t n, unsigned int i, OctreeNode<T, D>** out, unsigned int group = 16) const;
+
+    /**
+     * @brief      find face neighbors (equal or larger in size) for a batch
+     *             of nodes
+     *
+     * @param[in]  nodes  nodes
+     * @param[in]  n      number of nodes
+     * @param[in]  i      direction i (face direction)
+     * @param[out] out    pointers to the neighbors
+     * @param[in]  group  number of lookups in flight
+     */
+    inline void find_gteq_neighbors_face(OctreeNode<T, D>* const* nodes, size_t n, unsigned int i, OctreeNode<T, D>** out, unsigned int group = 16) const {
+        this->find_gteq_neighbors(nodes, n, i, out, group);
+    }
+
+    /**
+     * @brief      find the k objects nearest to a position
+     *
+     * @param[in]  _px   x position
+     * @param[in]  _py   y position
+     * @param[in]  _pz   z position
+     * @param[in]  k     number of objects
+     *
+     * @return     vector of pointers to objects, nearest first
+     */
+    std::vector<T*> find_nearest(double _px, double _py, double _pz, unsigned int k) const;
+
+    /**
+     * @brief      call a function for every pair of objects within a distance
+     *
+     * @param[in]  r     distance
+     * @param[in]  fn    function receiving both objects of the pair
+     */
+    void for_each_pair_within(double r, const std::function<void(T*, T*)>& fn) const;
+
+    /**
+     * @brief      find all objects overlapping a box
+     *
+     * Objects with a position count as boxes of zero size.
+     *
+     * @param[in]  _bmin  lower corner of the box
+     * @param[in]  _bmax  upper corner of the box
+     *
+     * @return     vector of pointers to objects
+     */
+    std::vector<T*> find_overlapping(const double _bmin[3], const double _bmax[3]) const;
+
+    /**
+     * @brief      call a function for every pair of objects with
+     *             overlapping boxes
+     *
+     * Objects with a position count as boxes of zero size. The pairs are
+     * processed in parallel, such that the function may be called
+     * concurrently.
+     *
+     * @param[in]  fn    function receiving both objects of the pair
+     */
+    void for_each_overlapping_pair(const std::function<void(T*, T*)>& fn) const;
+
+    /**
+     * @brief      recalculate the bounding boxes of the contents of all nodes
+     *
+     * The boxes are maintained upon adding objects; this function is meant
+     * to restore them after bulk changes.
+     */
+    void update_bounds();
+
+    /**
+     * @brief      refine the tree until it satisfies the 2:1 balance condition
+     *
+     * No leaf will have a face, edge or vertex neighbor that is more than
+     * one level coarser.
+     *
+     * @return     nodes that have been split
+     */
+    std::vector<OctreeNode<T, D>*> balance();
+
+    /**
+     * @brief      restore the 2:1 balance condition around changed nodes
+     *
+     * Only the leaves below the changed nodes (and the ripple they cause)
+     * are considered, which suffices when the tree was balanced before.
+     *
+     * @param[in]  changed  nodes that have been split since the tree was
+     *                      last balanced
+     *
+     * @return     nodes that have been split
+     */
+    std::vector<OctreeNode<T, D>*> balance(const std::vector<OctreeNode<T, D>*>& changed);
+
+    /**
+     * @brief      split leaves for which a predicate holds
+     *
+     * Repeats on the new leaves until the predicate no longer selects any
+     * of them; the predicate should therefore eventually return false.
+     *
+     * @param[in]  pred  predicate on a leaf (its box, level and contents)
+     *
+     * @return     nodes that have been split, including children that were
+     *             split because they received too many objects
+     */
+    std::vector<OctreeNode<T, D>*> refine(const std::function<bool(const OctreeNode<T, D>&)>& pred);
+
+    /**
+     * @brief      merge the children of nodes for which a predicate holds
+     *
+     * Only nodes whose children are all leaves are considered; repeats on
+     * the parents of the merged nodes.
+     *
+     * @param[in]  pred  predicate on a node (its box, level and the contents
+     *                   of its children)
+     *
+     * @return     nodes that have been turned into leaves
+     */
+    std::vector<OctreeNode<T, D>*> coarsen(const std::function<bool(const OctreeNode<T, D>&)>& pred);
+
+    /**
+     * @brief      partition the leaves into k chunks of balanced weight
+     *
+     * @param[in]  k          number of chunks
+     * @param[in]  weight_fn  weight of a leaf (defaults to its number of objects)
+     *
+     * @return     vector of k partitions
+     */
+    std::vector<OctreePartition<T, D>> partition(unsigned int k, const std::function<double(const OctreeNode<T, D>&)>& weight_fn = nullptr);
+
+private:
+    /**
+     * @brief      object with its position, used for bulk insertion
+     */
+    struct Entry {
+        double p[3];
+        T* object;
+    };
+
+    /**
+     * @brief      add a range of objects to a subtree
+     *
+     * @param      node   top of the subtree
+     * @param      first  first object
+     * @param      last   one past the last object
+     */
+    void add_range(OctreeNode<T, D>* node, Entry* first, Entry* last);
+
+    /**
+     * @brief      add object with a bounding box to a subtree
+     *
+     * @param      top     top of the subtree, its loose box should contain
+     *                     the bounding box
+     * @param      object  pointer to object
+     * @param[in]  _bmin   lower corner of the bounding box
+     * @param[in]  _bmax   upper corner of the bounding box
+     */
+    void add_box(OctreeNode<T, D>* top, T* object, const double _bmin[3], const double _bmax[3]);
+
+    /**
+     * @brief      move all objects of a node of another tree and its
+     *             subtree into a node of this tree covering the same cell
+     *
+     * @param      a     node of this tree
+     * @param      b     node of the other tree, left as an empty leaf
+     */
+    void merge_nodes(OctreeNode<T, D>* a, OctreeNode<T, D>* b);
+
+    /**
+     * @brief      append a subtree in van Emde Boas order
+     *
+     * The top half of the levels is laid out first, followed by the
+     * subtrees hanging below it, each recursively.
+     *
+     * @param      node    top of the subtree
+     * @param[in]  height  number of levels to lay out
+     * @param      order   nodes in layout order
+     */
+    void veb_order(OctreeNode<T, D>* node, unsigned int height, std::vector<OctreeNode<T, D>*>& order) const;
+
+    /**
+     * @brief      get an object held by a node itself with its box
+     *
+     * @param[in]  node   pointer to node
+     * @param[in]  i      index of the object (objects with a position first)
+     * @param[out] _bmin  lower corner of the box
+     * @param[out] _bmax  upper corner of the box
+     *
+     * @return     pointer to object
+     */
+    static T* get_item(const OctreeNode<T, D>* node, unsigned int i, double _bmin[3], double _bmax[3]);
+
+    /**
+     * @brief      call a function for every object in a subtree overlapping
+     *             a box
+     *
+     * @param[in]  top    top of the subtree
+     * @param[in]  _bmin  lower corner of the box
+     * @param[in]  _bmax  upper corner of the box
+     * @param[in]  fn     function receiving the object
+     */
+    template <class F>
+    void for_each_overlapping(const OctreeNode<T, D>* top, const double _bmin[3], const double _bmax[3], F fn) const;
+
+    /**
+     * @brief      report the overlapping pairs between the objects held by
+     *             two nodes themselves and their subtrees
+     *
+     * Both nodes are equal, or their subtrees are disjoint. The pairs of
+     * children that remain to be visited are pushed onto the stack.
+     *
+     * @param[in]  a      first node
+     * @param[in]  b      second node
+     * @param      stack  node pairs to visit
+     * @param[in]  fn     function receiving both objects of the pair
+     */
+    void overlap_step(const OctreeNode<T, D>* a, const OctreeNode<T, D>* b,
+                      std::vector<std::pair<const OctreeNode<T, D>*, const OctreeNode<T, D>*>>& stack,
+                      const std::function<void(T*, T*)>& fn) const;
+
+    /**
+     * @brief      split coarse neighbors of leaves until no leaf has a face,
+     *             edge or vertex neighbor more than one level coarser
+     *
+     * @param[in]  seeds  leaves to start from
+     *
+     * @return     nodes that have been split
+     */
+    std::vector<OctreeNode<T, D>*> balance_leaves(std::vector<OctreeNode<T, D>*> seeds);
+
+    /**
+     * @brief      evaluate a predicate in parallel on a list of nodes
+     *
+     * @param[in]  nodes  nodes to evaluate
+     * @param[in]  pred   predicate
+     *
+     * @return     nodes for which the predicate holds, in their original order
+     */
+    std::vector<OctreeNode<T, D>*> select(const std::vector<OctreeNode<T, D>*>& nodes, const std::function<bool(const OctreeNode<T, D>&)>& pred) const;
 };
 
 #include "octree.cpp"
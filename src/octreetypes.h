@@ -70,4 +70,158 @@ enum {
     OT_D_UNKNOWN
 };
 
+enum {
+    QT_LB,
+    QT_LF,
+    QT_RB,
+    QT_RF
+};
+
+enum {
+    QT_D_L,
+    QT_D_R,
+    QT_D_B,
+    QT_D_F,
+    QT_D_LB,
+    QT_D_LF,
+    QT_D_RB,
+    QT_D_RF,
+    QT_D_UNKNOWN
+};
+
+enum {
+    OT_ORDER_PRE,
+    OT_ORDER_POST
+};
+
+enum {
+    OT_LAYOUT_BFS,
+    OT_LAYOUT_DFS,
+    OT_LAYOUT_VEB
+};
+
+/**
+ * @brief      Direction and child label tables for a tree of dimension D
+ *
+ * A child label holds one bit per axis; the axes x, z and y (x and y in
+ * 2-D) map onto the bits from high to low. A direction points along one
+ * or more axes, and is described by a mask of these bits and the bits of
+ * the axes it points along in positive direction. Directions are ordered
+ * by the number of axes they point along, then lexicographically over
+ * their (axis, sign) pairs with the negative side first. This reproduces
+ * the OT_D_* labels for D = 3 and the QT_D_* labels for D = 2.
+ *
+ * The tables are generated at compile time from these bit rules:
+ *   adj:      the child lies on the side(s) of the direction
+ *   reflect:  the child mirrored along the axes of the direction
+ *   common:   the direction restricted to the axes along which the child
+ *             lies on the side of the direction (nr_directions if none)
+ *
+ * @tparam     D     dimension (2 or 3)
+ */
+template <unsigned int D>
+struct OctreeTables {
+    static_assert(D == 2 || D == 3, "only quadtrees and octrees are supported");
+
+    static constexpr unsigned int nr_children = 1u << D;
+    static constexpr unsigned int nr_directions = D == 2 ? 8 : 26;
+
+    unsigned char mask[nr_directions] = {};     //!< child label bits of the axes of a direction
+    unsigned char sign[nr_directions] = {};     //!< bits of the axes pointed along in positive direction
+    unsigned char rank[nr_directions] = {};     //!< number of axes of a direction
+
+    bool adj[nr_directions][nr_children] = {};
+    unsigned char reflect[nr_directions][nr_children] = {};
+    unsigned char common[nr_directions][nr_children] = {};
+
+    /**
+     * @brief      child label bit of an axis
+     *
+     * @param[in]  k     axis (0 for x, 1 for y, 2 for z)
+     *
+     * @return     bit (-1 if the axis is not subdivided)
+     */
+    static constexpr int axis_bit(unsigned int k) {
+        return D == 3 ? (k == 0 ? 2 : k == 1 ? 0 : 1) : (k == 0 ? 1 : k == 1 ? 0 : -1);
+    }
+
+    /**
+     * @brief      step of a direction along an axis
+     *
+     * @param[in]  i     direction
+     * @param[in]  k     axis (0 for x, 1 for y, 2 for z)
+     *
+     * @return     -1, 0 or 1
+     */
+    constexpr int offset(unsigned int i, unsigned int k) const {
+        const int b = axis_bit(k);
+        if(b < 0 || !(this->mask[i] & (1u << b))) {
+            return 0;
+        }
+        return (this->sign[i] & (1u << b)) ? 1 : -1;
+    }
+
+    constexpr OctreeTables() {
+        // the axes in label order, most significant bit first
+        const unsigned int base = 2 * D;
+        unsigned long long span = 1;
+        for(unsigned int a=0; a<D; a++) {
+            span *= base;
+        }
+
+        // sort the sign vectors (base 3 digits: 0 none, 1 negative, 2
+        // positive) by their keys
+        unsigned int nvec = 1;
+        for(unsigned int a=0; a<D; a++) {
+            nvec *= 3;
+        }
+
+        unsigned long long last = 0;
+        for(unsigned int i=0; i<nr_directions; i++) {
+            unsigned long long best = ~0ull;
+            for(unsigned int v=1; v<nvec; v++) {
+                unsigned long long code = 0;
+                unsigned int k = 0, m = 0, s = 0;
+                for(unsigned int a=0, t=v; a<D; a++, t/=3) {
+                    if(t % 3 != 0) {
+                        code = code * base + 2 * a + (t % 3 == 2 ? 1 : 0);
+                        m |= 1u << (D - 1 - a);
+                        s |= (t % 3 == 2 ? 1u : 0u) << (D - 1 - a);
+                        k++;
+                    }
+                }
+                for(unsigned int a=k; a<D; a++) {
+                    code *= base;
+                }
+
+                const unsigned long long key = k * span + code;
+                if(key > last && key < best) {
+                    best = key;
+                    this->mask[i] = m;
+                    this->sign[i] = s;
+                    this->rank[i] = k;
+                }
+            }
+            last = best;
+        }
+
+        for(unsigned int i=0; i<nr_directions; i++) {
+            for(unsigned int o=0; o<nr_children; o++) {
+                const unsigned int match = ~(o ^ this->sign[i]) & this->mask[i];
+                this->adj[i][o] = match == this->mask[i];
+                this->reflect[i][o] = o ^ this->mask[i];
+                this->common[i][o] = nr_directions;
+                for(unsigned int j=0; j<nr_directions; j++) {
+                    if(match != 0 && this->mask[j] == match && this->sign[j] == (this->sign[i] & match)) {
+                        this->common[i][o] = j;
+                    }
+                }
+            }
+        }
+    }
+};
+
+template <unsigned int D>
+inline constexpr OctreeTables<D> octree_tables{};
+
 #endif // _OCTREETYPES_H
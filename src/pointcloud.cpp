@@ -0,0 +1,448 @@
+ /***********************************************************************************
+ #   This file is part of octree.                                                   #
+ #                                                                                  #
+ #   MIT License                                                                    #
+ #                                                                                  #
+ #   Copyright (c) 2018 Ivo Filot <ivo@ivofilot.nl>                                 #
+ #                                                                                  #
+ #   Permission is hereby granted, free of charge, to any person obtaining a copy   #
+ #   of this software and associated documentation files (the "Software"), to deal  #
+ #   in the Software without restriction, including without limitation the rights   #
+ #   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell      #
+ #   copies of the Software, and to permit persons to whom the Software is          #
+ #   furnished to do so, subject to the following conditions:                       #
+ #                                                                                  #
+ #   The above copyright notice and this permission notice shall be included in all #
+ #   copies or substantial portions of the Software.                                #
+ #                                                                                  #
+ #   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR     #
+ #   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,       #
+ #   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE    #
+ #   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER         #
+ #   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  #
+ #   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  #
+ #   SOFTWARE.                                                                      #
+ #                                                                                  #
+ #***********************************************************************************/
+
+#include "pointcloud.h"
+
+#include <charconv>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+namespace {
+
+/**
+ * @brief      check whether a character separates values on a line
+ */
+inline bool is_separator(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == ',' || c == ';';
+}
+
+/**
+ * @brief      parse a value and the separators following it
+ *
+ * @param      p     position in the line, advanced past the value
+ * @param[in]  end   end of the line
+ * @param[out] v     value
+ *
+ * @return     whether a complete value was parsed
+ */
+inline bool parse_value(const char*& p, const char* end, double* v) {
+    const char* q = (p < end && *p == '+') ? p + 1 : p;
+    const auto res = std::from_chars(q, end, *v);
+    if(res.ec != std::errc() || (res.ptr != end && !is_separator(*res.ptr))) {
+        return false;
+    }
+
+    p = res.ptr;
+    while(p < end && is_separator(*p)) {
+        p++;
+    }
+
+    return true;
+}
+
+/**
+ * @brief      parse a line holding three values, optionally after a label
+ *
+ * @param[in]  p     begin of the line
+ * @param[in]  end   end of the line
+ * @param[out] v     values
+ *
+ * @return     whether the line holds a point
+ */
+bool parse_line(const char* p, const char* end, double v[3]) {
+    while(p < end && is_separator(*p)) {
+        p++;
+    }
+
+    const char* start = p;
+    if(parse_value(p, end, &v[0]) && parse_value(p, end, &v[1]) && parse_value(p, end, &v[2])) {
+        return true;
+    }
+
+    // skip a leading label and try again
+    p = start;
+    while(p < end && !is_separator(*p)) {
+        p++;
+    }
+    while(p < end && is_separator(*p)) {
+        p++;
+    }
+
+    return p != start && p < end &&
+           parse_value(p, end, &v[0]) && parse_value(p, end, &v[1]) && parse_value(p, end, &v[2]);
+}
+
+/**
+ * @brief      PLY scalar types
+ */
+enum {
+    PLY_INT8,
+    PLY_UINT8,
+    PLY_INT16,
+    PLY_UINT16,
+    PLY_INT32,
+    PLY_UINT32,
+    PLY_FLOAT32,
+    PLY_FLOAT64,
+    PLY_UNKNOWN
+};
+
+/**
+ * @brief      get the PLY scalar type from its name
+ */
+unsigned int ply_type(const std::string& name) {
+    static const char* names[][2] = {
+        {"char", "int8"},
+        {"uchar", "uint8"},
+        {"short", "int16"},
+        {"ushort", "uint16"},
+        {"int", "int32"},
+        {"uint", "uint32"},
+        {"float", "float32"},
+        {"double", "float64"}
+    };
+
+    for(unsigned int i=0; i<PLY_UNKNOWN; i++) {
+        if(name == names[i][0] || name == names[i][1]) {
+            return i;
+        }
+    }
+
+    return PLY_UNKNOWN;
+}
+
+/**
+ * @brief      get the size of a PLY scalar type in bytes
+ */
+inline size_t ply_size(unsigned int type) {
+    static const size_t sizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+    return sizes[type];
+}
+
+/**
+ * @brief      read a little endian PLY scalar as double
+ */
+inline double ply_read(const char* p, unsigned int type) {
+    switch(type) {
+        case PLY_INT8:    { int8_t v;   std::memcpy(&v, p, sizeof(v)); return v; }
+        case PLY_UINT8:   { uint8_t v;  std::memcpy(&v, p, sizeof(v)); return v; }
+        case PLY_INT16:   { int16_t v;  std::memcpy(&v, p, sizeof(v)); return v; }
+        case PLY_UINT16:  { uint16_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+        case PLY_INT32:   { int32_t v;  std::memcpy(&v, p, sizeof(v)); return v; }
+        case PLY_UINT32:  { uint32_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+        case PLY_FLOAT32: { float v;    std::memcpy(&v, p, sizeof(v)); return v; }
+        default:          { double v;   std::memcpy(&v, p, sizeof(v)); return v; }
+    }
+}
+
+/**
+ * @brief      split a header line into words
+ */
+std::vector<std::string> split_words(const char* p, const char* end) {
+    std::vector<std::string> words;
+    while(p < end) {
+        while(p < end && is_separator(*p)) {
+            p++;
+        }
+        const char* start = p;
+        while(p < end && !is_separator(*p)) {
+            p++;
+        }
+        if(p != start) {
+            words.emplace_back(start, p);
+        }
+    }
+
+    return words;
+}
+
+} // namespace
+
+/**
+ * @brief      load a point cloud from file
+ *
+ * The format is determined from the extension: .ply for binary little
+ * endian PLY files, anything else is read as ASCII XYZ.
+ *
+ * @param[in]  filename  path to file
+ */
+PointCloud::PointCloud(const std::string& filename) {
+    if(!boost::filesystem::is_regular_file(filename)) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+
+    // an empty file cannot be mapped and holds no points
+    if(boost::filesystem::file_size(filename) == 0) {
+        return;
+    }
+
+    boost::iostreams::mapped_file_source file(filename);
+
+    std::string ext = boost::filesystem::path(filename).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+        return std::tolower(c);
+    });
+
+    if(ext == ".ply") {
+        this->parse_ply(file.data(), file.size());
+    } else {
+        this->parse_xyz(file.data(), file.size());
+    }
+
+    this->indices.resize(this->xyz.size() / 3);
+    #pragma omp parallel for
+    for(size_t i=0; i<this->indices.size(); i++) {
+        this->indices[i] = i;
+    }
+}
+
+/**
+ * @brief      get the bounding box of the points
+ *
+ * @param[out] bmin  lower corner
+ * @param[out] bmax  upper corner
+ */
+void PointCloud::get_bounds(double bmin[3], double bmax[3]) const {
+    double lx = std::numeric_limits<double>::max(), ly = lx, lz = lx;
+    double hx = std::numeric_limits<double>::lowest(), hy = hx, hz = hx;
+
+    const double* p = this->xyz.data();
+    const size_t n = this->size();
+
+    #pragma omp parallel for reduction(min:lx,ly,lz) reduction(max:hx,hy,hz)
+    for(size_t i=0; i<n; i++) {
+        lx = std::min(lx, p[i*3]);
+        ly = std::min(ly, p[i*3+1]);
+        lz = std::min(lz, p[i*3+2]);
+        hx = std::max(hx, p[i*3]);
+        hy = std::max(hy, p[i*3+1]);
+        hz = std::max(hz, p[i*3+2]);
+    }
+
+    bmin[0] = lx; bmin[1] = ly; bmin[2] = lz;
+    bmax[0] = hx; bmax[1] = hy; bmax[2] = hz;
+}
+
+/**
+ * @brief      parse ASCII XYZ data
+ *
+ * Every line holding three numbers, optionally preceded by a label
+ * (such as an element symbol), yields a point; other lines are skipped.
+ * The data is cut into chunks at line boundaries which are parsed in
+ * parallel and concatenated in order.
+ *
+ * @param[in]  data  pointer to data
+ * @param[in]  size  size of the data in bytes
+ */
+void PointCloud::parse_xyz(const char* data, size_t size) {
+    static const size_t chunk_size = 1 << 20;
+    const size_t nchunks = size / chunk_size + 1;
+
+    // chunk boundaries, moved forward to the start of the next line
+    std::vector<size_t> bounds(nchunks + 1, size);
+    bounds[0] = 0;
+    for(size_t k=1; k<nchunks; k++) {
+        const char* nl = static_cast<const char*>(std::memchr(data + k * chunk_size, '\n', size - k * chunk_size));
+        bounds[k] = std::max(bounds[k-1], nl ? (size_t)(nl - data) + 1 : size);
+    }
+
+    std::vector<std::vector<double>> parts(nchunks);
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t k=0; k<nchunks; k++) {
+        const char* p = data + bounds[k];
+        const char* end = data + bounds[k+1];
+        std::vector<double>& out = parts[k];
+        out.reserve((end - p) / 8);
+
+        while(p < end) {
+            const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if(eol == nullptr) {
+                eol = end;
+            }
+
+            double v[3];
+            if(parse_line(p, eol, v)) {
+                out.insert(out.end(), v, v + 3);
+            }
+            p = eol + 1;
+        }
+    }
+
+    std::vector<size_t> offsets(nchunks + 1, 0);
+    for(size_t k=0; k<nchunks; k++) {
+        offsets[k+1] = offsets[k] + parts[k].size();
+    }
+
+    this->xyz.resize(offsets[nchunks]);
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t k=0; k<nchunks; k++) {
+        std::copy(parts[k].begin(), parts[k].end(), this->xyz.begin() + offsets[k]);
+    }
+}
+
+/**
+ * @brief      parse binary little endian PLY data
+ *
+ * The x, y and z properties of the vertex element are read; any other
+ * properties are skipped. Elements preceding the vertex element may not
+ * hold list properties.
+ *
+ * @param[in]  data  pointer to data
+ * @param[in]  size  size of the data in bytes
+ */
+void PointCloud::parse_ply(const char* data, size_t size) {
+    struct Element {
+        std::string name;
+        size_t count;
+        size_t stride;
+        bool fixed;
+        size_t offset[3];
+        unsigned int type[3];
+    };
+
+    const uint16_t probe = 1;
+    if(*reinterpret_cast<const uint8_t*>(&probe) != 1) {
+        throw std::runtime_error("PLY reading requires a little endian host");
+    }
+
+    std::vector<Element> elements;
+    const char* p = data;
+    const char* end = data + size;
+    bool header_done = false;
+    bool first = true;
+
+    while(p < end && !header_done) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if(eol == nullptr) {
+            throw std::runtime_error("Unterminated PLY header");
+        }
+
+        const std::vector<std::string> words = split_words(p, eol);
+        p = eol + 1;
+
+        if(first) {
+            if(words.size() != 1 || words[0] != "ply") {
+                throw std::runtime_error("Not a PLY file");
+            }
+            first = false;
+        } else if(words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+            continue;
+        } else if(words[0] == "format") {
+            if(words.size() < 2 || words[1] != "binary_little_endian") {
+                throw std::runtime_error("Unsupported PLY format, only binary_little_endian can be read");
+            }
+        } else if(words[0] == "element" && words.size() == 3) {
+            size_t count = 0;
+            const char* last = words[2].data() + words[2].size();
+            const auto res = std::from_chars(words[2].data(), last, count);
+            if(res.ec != std::errc() || res.ptr != last) {
+                throw std::runtime_error("Invalid PLY element count: " + words[2]);
+            }
+            elements.push_back({words[1], count, 0, true,
+                                {0, 0, 0}, {PLY_UNKNOWN, PLY_UNKNOWN, PLY_UNKNOWN}});
+        } else if(words[0] == "property" && words.size() >= 3 && !elements.empty()) {
+            Element& el = elements.back();
+            if(words[1] == "list") {
+                el.fixed = false;
+                continue;
+            }
+
+            const unsigned int type = ply_type(words[1]);
+            if(type == PLY_UNKNOWN) {
+                throw std::runtime_error("Unknown PLY property type: " + words[1]);
+            }
+
+            const int axis = words[2] == "x" ? 0 : words[2] == "y" ? 1 : words[2] == "z" ? 2 : -1;
+            if(axis >= 0) {
+                el.offset[axis] = el.stride;
+                el.type[axis] = type;
+            }
+            el.stride += ply_size(type);
+        } else if(words[0] == "end_header") {
+            header_done = true;
+        } else {
+            throw std::runtime_error("Invalid PLY header line");
+        }
+    }
+
+    if(!header_done) {
+        throw std::runtime_error("Unterminated PLY header");
+    }
+
+    // skip the elements preceding the vertex element; the counts are taken
+    // from the header, such that the sizes are checked before multiplying
+    const size_t remaining = end - p;
+    size_t skip = 0;
+    const Element* vertex = nullptr;
+    for(const Element& el : elements) {
+        if(el.name == "vertex") {
+            vertex = &el;
+            break;
+        }
+        if(!el.fixed) {
+            throw std::runtime_error("Cannot skip PLY element with list properties: " + el.name);
+        }
+        if(el.stride != 0 && el.count > (remaining - skip) / el.stride) {
+            throw std::runtime_error("Truncated PLY file");
+        }
+        skip += el.count * el.stride;
+    }
+
+    if(vertex == nullptr) {
+        return;
+    }
+    if(!vertex->fixed) {
+        throw std::runtime_error("PLY vertex element with list properties is not supported");
+    }
+    for(unsigned int j=0; j<3; j++) {
+        if(vertex->type[j] == PLY_UNKNOWN) {
+            throw std::runtime_error("PLY vertex element lacks x, y or z");
+        }
+    }
+    if(vertex->count > (remaining - skip) / vertex->stride) {
+        throw std::runtime_error("Truncated PLY file");
+    }
+
+    const char* base = p + skip;
+    const size_t n = vertex->count;
+    this->xyz.resize(n * 3);
+
+    #pragma omp parallel for
+    for(size_t i=0; i<n; i++) {
+        const char* rec = base + i * vertex->stride;
+        for(unsigned int j=0; j<3; j++) {
+            this->xyz[i*3+j] = ply_read(rec + vertex->offset[j], vertex->type[j]);
+        }
+    }
+}
@@ -0,0 +1,116 @@
+ /***********************************************************************************
+ #   This file is part of octree.                                                   #
+ #                                                                                  #
+ #   MIT License                                                                    #
+ #                                                                                  #
+ #   Copyright (c) 2018 Ivo Filot <ivo@ivofilot.nl>                                 #
+ #                                                                                  #
+ #   Permission is hereby granted, free of charge, to any person obtaining a copy   #
+ #   of this software and associated documentation files (the "Software"), to deal  #
+ #   in the Software without restriction, including without limitation the rights   #
+ #   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell      #
+ #   copies of the Software, and to permit persons to whom the Software is          #
+ #   furnished to do so, subject to the following conditions:                       #
+ #                                                                                  #
+ #   The above copyright notice and this permission notice shall be included in all #
+ #   copies or substantial portions of the Software.                                #
+ #                                                                                  #
+ #   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR     #
+ #   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,       #
+ #   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE    #
+ #   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER         #
+ #   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  #
+ #   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  #
+ #   SOFTWARE.                                                                      #
+ #                                                                                  #
+ #***********************************************************************************/
+
+#ifndef _POINTCLOUD_H
+#define _POINTCLOUD_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief      Class for point cloud loaded from file.
+ *
+ * The file is memory-mapped and parsed in parallel chunks. The positions
+ * are stored as one contiguous array that can be passed directly to
+ * Octree<size_t>::add_many together with pointers into the index array
+ * as handles.
+ */
+class PointCloud {
+
+private:
+    std::vector<double> xyz;        //!< positions (x, y and z for every point)
+    std::vector<size_t> indices;    //!< index of every point, used as object handle
+
+public:
+    /**
+     * @brief      load a point cloud from file
+     *
+     * The format is determined from the extension: .ply for binary little
+     * endian PLY files, anything else is read as ASCII XYZ.
+     *
+     * @param[in]  filename  path to file
+     */
+    PointCloud(const std::string& filename);
+
+    /**
+     * @brief      get the number of points
+     *
+     * @return     number of points
+     */
+    inline size_t size() const {
+        return this->indices.size();
+    }
+
+    /**
+     * @brief      get the positions
+     *
+     * @return     pointer to x, y and z of every point
+     */
+    inline const double* get_positions() const {
+        return this->xyz.data();
+    }
+
+    /**
+     * @brief      get the object handles
+     *
+     * @return     pointer to the index of every point
+     */
+    inline size_t* get_indices() {
+        return this->indices.data();
+    }
+
+    /**
+     * @brief      get the bounding box of the points
+     *
+     * @param[out] bmin  lower corner
+     * @param[out] bmax  upper corner
+     */
+    void get_bounds(double bmin[3], double bmax[3]) const;
+
+private:
+    /**
+     * @brief      parse ASCII XYZ data
+     *
+     * Every line holding three numbers, optionally preceded by a label
+     * (such as an element symbol), yields a point; other lines are skipped.
+     *
+     * @param[in]  data  pointer to data
+     * @param[in]  size  size of the data in bytes
+     */
+    void parse_xyz(const char* data, size_t size);
+
+    /**
+     * @brief      parse binary little endian PLY data
+     *
+     * @param[in]  data  pointer to data
+     * @param[in]  size  size of the data in bytes
+     */
+    void parse_ply(const char* data, size_t size);
+};
+
+#endif // _POINTCLOUD_H
@@ -0,0 +1,295 @@
+ /***********************************************************************************
+ #   This file is part of octree.                                                   #
+ #                                                                                  #
+ #   MIT License                                                                    #
+ #                                                                                  #
+ #   Copyright (c) 2018 Ivo Filot <ivo@ivofilot.nl>                                 #
+ #                                                                                  #
+ #   Permission is hereby granted, free of charge, to any person obtaining a copy   #
+ #   of this software and associated documentation files (the "Software"), to deal  #
+ #   in the Software without restriction, including without limitation the rights   #
+ #   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell      #
+ #   copies of the Software, and to permit persons to whom the Software is          #
+ #   furnished to do so, subject to the following conditions:                       #
+ #                                                                                  #
+ #   The above copyright notice and this permission notice shall be included in all #
+ #   copies or substantial portions of the Software.                                #
+ #                                                                                  #
+ #   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR     #
+ #   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,       #
+ #   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE    #
+ #   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER         #
+ #   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  #
+ #   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  #
+ #   SOFTWARE.                                                                      #
+ #                                                                                  #
+ #***********************************************************************************/
+
+
+#include "snapshotoctree.h"
+
+#ifndef _SNAPSHOTOCTREE_IMPL
+#define _SNAPSHOTOCTREE_IMPL
+
+/**
+ * @brief      Octree constructor
+ *
+ * @param[in]  _x    width of principal cell
+ * @param[in]  _y    breadth of principal cell
+ * @param[in]  _z    height of principal cell
+ */
+template <class T>
+SnapshotOctree<T>::SnapshotOctree(double _x, double _y, double _z) :
+    root(std::make_shared<const SnapshotOctreeNode<T>>(_x/2, _y/2, _z/2, _x, _y, _z, 0)) {}
+
+/**
+ * @brief      add object to the tree and publish the new version
+ *
+ * @param      object  pointer to object
+ * @param[in]  _px     x position
+ * @param[in]  _py     y position
+ * @param[in]  _pz     z position
+ */
+template <class T>
+void SnapshotOctree<T>::add(T* object, double _px, double _py, double _pz) {
+    std::lock_guard<std::mutex> lock(this->writer);
+    const NodePtr current = std::atomic_load(&this->root);
+    std::atomic_store(&this->root, insert(*current, object, _px, _py, _pz));
+}
+
+/**
+ * @brief      split the leaf containing a position and publish the new
+ *             version
+ *
+ * @param[in]  _px   x position
+ * @param[in]  _py   y position
+ * @param[in]  _pz   z position
+ */
+template <class T>
+void SnapshotOctree<T>::split(double _px, double _py, double _pz) {
+    std::lock_guard<std::mutex> lock(this->writer);
+    const NodePtr current = std::atomic_load(&this->root);
+    std::atomic_store(&this->root, split(*current, _px, _py, _pz));
+}
+
+/**
+ * @brief      copy the path towards a position and add an object to
+ *             the leaf at its end
+ *
+ * @param[in]  node    node to copy
+ * @param      object  pointer to object
+ * @param[in]  _px     x position
+ * @param[in]  _py     y position
+ * @param[in]  _pz     z position
+ *
+ * @return     copy of the node
+ */
+template <class T>
+typename SnapshotOctree<T>::NodePtr SnapshotOctree<T>::insert(const SnapshotOctreeNode<T>& node, T* object, double _px, double _py, double _pz) {
+    std::shared_ptr<SnapshotOctreeNode<T>> copy = std::make_shared<SnapshotOctreeNode<T>>(node);
+
+    if(copy->is_leaf()) {
+        copy->objects.push_back(object);
+        copy->pos.push_back(_px);
+        copy->pos.push_back(_py);
+        copy->pos.push_back(_pz);
+
+        if(copy->objects.size() >= 16 && copy->level < max_level) {
+            split_leaf(*copy);
+        }
+    } else {
+        const unsigned int o = node.get_octant(_px, _py, _pz);
+        copy->children[o] = insert(*node.children[o], object, _px, _py, _pz);
+    }
+
+    return copy;
+}
+
+/**
+ * @brief      copy the path towards a position and split the leaf at
+ *             its end
+ *
+ * @param[in]  node  node to copy
+ * @param[in]  _px   x position
+ * @param[in]  _py   y position
+ * @param[in]  _pz   z position
+ *
+ * @return     copy of the node
+ */
+template <class T>
+typename SnapshotOctree<T>::NodePtr SnapshotOctree<T>::split(const SnapshotOctreeNode<T>& node, double _px, double _py, double _pz) {
+    std::shared_ptr<SnapshotOctreeNode<T>> copy = std::make_shared<SnapshotOctreeNode<T>>(node);
+
+    if(copy->is_leaf()) {
+        split_leaf(*copy);
+    } else {
+        const unsigned int o = node.get_octant(_px, _py, _pz);
+        copy->children[o] = split(*node.children[o], _px, _py, _pz);
+    }
+
+    return copy;
+}
+
+/**
+ * @brief      distribute the objects of an unpublished leaf over 8 new
+ *             children
+ *
+ * @param      node  leaf to split
+ */
+template <class T>
+void SnapshotOctree<T>::split_leaf(SnapshotOctreeNode<T>& node) {
+    const double nx = node.x / 2.0;
+    const double ny = node.y / 2.0;
+    const double nz = node.z / 2.0;
+
+    std::shared_ptr<SnapshotOctreeNode<T>> children[8];
+    for(unsigned int o=0; o<8; o++) {
+        children[o] = std::make_shared<SnapshotOctreeNode<T>>(node.cx + ((o >> 2) & 1 ? nx : -nx) / 2.0,
+                                                              node.cy + (o & 1 ? ny : -ny) / 2.0,
+                                                              node.cz + ((o >> 1) & 1 ? nz : -nz) / 2.0,
+                                                              nx, ny, nz, node.level + 1);
+    }
+
+    // migrate objects
+    for(unsigned int i=0; i<node.objects.size(); i++) {
+        const double* p = &node.pos[i*3];
+        SnapshotOctreeNode<T>& child = *children[node.get_octant(p[0], p[1], p[2])];
+        child.objects.push_back(node.objects[i]);
+        child.pos.insert(child.pos.end(), p, p + 3);
+    }
+
+    node.objects.clear();
+    node.pos.clear();
+
+    for(unsigned int o=0; o<8; o++) {
+        if(children[o]->objects.size() >= 16 && node.level + 1 < max_level) {
+            split_leaf(*children[o]);
+        }
+        node.children[o] = children[o];
+    }
+}
+
+/**
+ * @brief      find node given position
+ *
+ * @param[in]  _px   position x
+ * @param[in]  _py   position y
+ * @param[in]  _pz   position z
+ *
+ * @return     pointer to leaf
+ */
+template <class T>
+const SnapshotOctreeNode<T>* OctreeSnapshot<T>::find_node(double _px, double _py, double _pz) const {
+    const SnapshotOctreeNode<T>* node = this->root.get();
+    while(!node->is_leaf()) {
+        node = node->get_child(node->get_octant(_px, _py, _pz));
+    }
+
+    return node;
+}
+
+/**
+ * @brief      find neighbor (equal or larger in size) in direction i
+ *
+ * Locates the node at a point inside the equally sized cell adjacent in
+ * direction i, descending no deeper than the level of the node.
+ *
+ * @param[in]  node  pointer to node
+ * @param[in]  i     direction i (OT_D_*)
+ *
+ * @return     pointer to neighbor or nullptr at the domain boundary
+ */
+template <class T>
+const SnapshotOctreeNode<T>* OctreeSnapshot<T>::find_gteq_neighbor(const SnapshotOctreeNode<T>* node, unsigned int i) const {
+    constexpr const OctreeTables<3>& tables = octree_tables<3>;
+
+    const double px = node->get_cx() + tables.offset(i, 0) * 0.75 * node->get_x();
+    const double py = node->get_cy() + tables.offset(i, 1) * 0.75 * node->get_y();
+    const double pz = node->get_cz() + tables.offset(i, 2) * 0.75 * node->get_z();
+
+    const SnapshotOctreeNode<T>* q = this->root.get();
+    if(std::fabs(px - q->get_cx()) > q->get_x() / 2.0 ||
+       std::fabs(py - q->get_cy()) > q->get_y() / 2.0 ||
+       std::fabs(pz - q->get_cz()) > q->get_z() / 2.0) {
+        return nullptr;
+    }
+
+    while(!q->is_leaf() && q->get_level() < node->get_level()) {
+        q = q->get_child(q->get_octant(px, py, pz));
+    }
+
+    return q;
+}
+
+/**
+ * @brief      find neighbors
+ *
+ * @param[in]  node  pointer to node
+ *
+ * @return     vector holding pointers to neighbor nodes
+ */
+template <class T>
+std::vector<const SnapshotOctreeNode<T>*> OctreeSnapshot<T>::find_neighbors(const SnapshotOctreeNode<T>* node) const {
+    std::vector<const SnapshotOctreeNode<T>*> neighbors;
+    neighbors.reserve(26);
+
+    for(unsigned int i=0; i<26; i++) {
+        const SnapshotOctreeNode<T>* q = this->find_gteq_neighbor(node, i);
+        if(q != nullptr && std::find(neighbors.begin(), neighbors.end(), q) == neighbors.end()) {
+            neighbors.push_back(q);
+        }
+    }
+
+    return neighbors;
+}
+
+/**
+ * @brief      find all objects within a distance from a position
+ *
+ * @param[in]  _px   x position
+ * @param[in]  _py   y position
+ * @param[in]  _pz   z position
+ * @param[in]  r     radius
+ *
+ * @return     vector of pointers to objects
+ */
+template <class T>
+std::vector<T*> OctreeSnapshot<T>::find_within_radius(double _px, double _py, double _pz, double r) const {
+    std::vector<T*> result;
+    std::vector<const SnapshotOctreeNode<T>*> stack(1, this->root.get());
+    const double r2 = r * r;
+
+    while(!stack.empty()) {
+        const SnapshotOctreeNode<T>* node = stack.back();
+        stack.pop_back();
+
+        // distance from position to the cell
+        const double dx = std::max(std::fabs(_px - node->get_cx()) - node->get_x() / 2.0, 0.0);
+        const double dy = std::max(std::fabs(_py - node->get_cy()) - node->get_y() / 2.0, 0.0);
+        const double dz = std::max(std::fabs(_pz - node->get_cz()) - node->get_z() / 2.0, 0.0);
+        if(dx * dx + dy * dy + dz * dz > r2) {
+            continue;
+        }
+
+        if(!node->is_leaf()) {
+            for(unsigned int o=0; o<8; o++) {
+                stack.push_back(node->get_child(o));
+            }
+            continue;
+        }
+
+        const std::vector<double>& pos = node->get_positions();
+        for(unsigned int i=0; i<node->get_objects().size(); i++) {
+            const double ex = pos[i*3] - _px;
+            const double ey = pos[i*3+1] - _py;
+            const double ez = pos[i*3+2] - _pz;
+            if(ex * ex + ey * ey + ez * ez <= r2) {
+                result.push_back(node->get_objects()[i]);
+            }
+        }
+    }
+
+    return result;
+}
+
+#endif // _SNAPSHOTOCTREE_IMPL
@@ -0,0 +1,388 @@
+ /***********************************************************************************
+ #   This file is part of octree.                                                   #
+ #                                                                                  #
+ #   MIT License                                                                    #
+ #                                                                                  #
+ #   Copyright (c) 2018 Ivo Filot <ivo@ivofilot.nl>                                 #
+ #                                                                                  #
+ #   Permission is hereby granted, free of charge, to any person obtaining a copy   #
+ #   of this software and associated documentation files (the "Software"), to deal  #
+ #   in the Software without restriction, including without limitation the rights   #
+ #   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell      #
+ #   copies of the Software, and to permit persons to whom the Software is          #
+ #   furnished to do so, subject to the following conditions:                       #
+ #                                                                                  #
+ #   The above copyright notice and this permission notice shall be included in all #
+ #   copies or substantial portions of the Software.                                #
+ #                                                                                  #
+ #   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR     #
+ #   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,       #
+ #   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE    #
+ #   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER         #
+ #   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  #
+ #   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  #
+ #   SOFTWARE.                                                                      #
+ #                                                                                  #
+ #***********************************************************************************/
+
+
+#ifndef _SNAPSHOTOCTREE_H
+#define _SNAPSHOTOCTREE_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+
+#include "octreetypes.h"
+
+/*
+ * Octree supporting a single writer and many concurrent readers.
+ *
+ * Nodes are immutable once published. An update copies the path from the
+ * root to the modified leaf (copy-on-write) and publishes the new root
+ * atomically, so every reader keeps working on the consistent version it
+ * obtained through snapshot(). Nodes are shared between versions through
+ * reference counting; a version is reclaimed when the last snapshot that
+ * refers to it is released.
+ *
+ * As nodes are shared between versions they have no parent pointers;
+ * neighbors are therefore found top-down rather than via the parent
+ * pointers used by OctreeNode.
+ */
+
+/**
+ * @brief      Class for immutable octree node.
+ *
+ * @tparam     T     object class
+ */
+template <class T>
+class SnapshotOctreeNode {
+
+private:
+    double cx;      //!< center position x
+    double cy;      //!< center position y
+    double cz;      //!< center position z
+
+    double x;       //!< width of the cell
+    double y;       //!< breadth of the cell
+    double z;       //!< height of the cell
+
+    unsigned int level;     //!< level of the node
+
+    std::shared_ptr<const SnapshotOctreeNode> children[8];  //!< children (all empty for a leaf)
+
+    std::vector<T*> objects;    //!< vector of pointers to objects
+    std::vector<double> pos;    //!< positions of the objects
+
+public:
+    /**
+     * @brief      Constructs the object.
+     *
+     * @param[in]  _cx      center position x
+     * @param[in]  _cy      center position y
+     * @param[in]  _cz      center position z
+     * @param[in]  _x       width of the cell
+     * @param[in]  _y       breadth of the cell
+     * @param[in]  _z       height of the cell
+     * @param[in]  _level   The level
+     */
+    SnapshotOctreeNode(double _cx, double _cy, double _cz,
+                       double _x, double _y, double _z,
+                       unsigned int _level) :
+        cx(_cx),
+        cy(_cy),
+        cz(_cz),
+        x(_x),
+        y(_y),
+        z(_z),
+        level(_level) {}
+
+    /**
+     * @brief      get child node given octant position
+     *
+     * @param[in]  o     the octant position
+     *
+     * @return     pointer to child node
+     */
+    inline const SnapshotOctreeNode* get_child(unsigned int o) const {
+        return this->children[o].get();
+    }
+
+    /**
+     * @brief      determines if node is leaf
+     *
+     * @return     True if leaf, False otherwise.
+     */
+    inline bool is_leaf() const {
+        return !this->children[0];
+    }
+
+    /**
+     * @brief      get the octant that contains a position
+     *
+     * @param[in]  _px   position x
+     * @param[in]  _py   position y
+     * @param[in]  _pz   position z
+     *
+     * @return     octant label
+     */
+    inline unsigned int get_octant(double _px, double _py, double _pz) const {
+        return ((_px < this->cx ? 0 : 1) << 2) | ((_pz < this->cz ? 0 : 1) << 1) | (_py < this->cy ? 0 : 1);
+    }
+
+    /**
+     * @brief      get node center x
+     *
+     * @return     node center x
+     */
+    inline double get_cx() const {
+        return this->cx;
+    }
+
+    /**
+     * @brief      get node center y
+     *
+     * @return     node center y
+     */
+    inline double get_cy() const {
+        return this->cy;
+    }
+
+    /**
+     * @brief      get node center z
+     *
+     * @return     node center z
+     */
+    inline double get_cz() const {
+        return this->cz;
+    }
+
+    /**
+     * @brief      get width of the cell
+     *
+     * @return     width of the cell
+     */
+    inline double get_x() const {
+        return this->x;
+    }
+
+    /**
+     * @brief      get breadth of the cell
+     *
+     * @return     breadth of the cell
+     */
+    inline double get_y() const {
+        return this->y;
+    }
+
+    /**
+     * @brief      get height of the cell
+     *
+     * @return     height of the cell
+     */
+    inline double get_z() const {
+        return this->z;
+    }
+
+    /**
+     * @brief      get node level
+     *
+     * @return     level of the node (root is at level 0)
+     */
+    inline unsigned int get_level() const {
+        return this->level;
+    }
+
+    /**
+     * @brief      get the objects of the node
+     *
+     * @return     vector of pointer to objects
+     */
+    inline const std::vector<T*>& get_objects() const {
+        return this->objects;
+    }
+
+    /**
+     * @brief      get the positions of the objects
+     *
+     * @return     vector holding x, y and z of every object
+     */
+    inline const std::vector<double>& get_positions() const {
+        return this->pos;
+    }
+
+    template <class U> friend class SnapshotOctree;
+};
+
+/**
+ * @brief      Consistent read-only view on a SnapshotOctree
+ *
+ * Holds a reference to the version of the tree that was current when the
+ * snapshot was taken; later updates are not visible.
+ *
+ * @tparam     T     object class
+ */
+template <class T>
+class OctreeSnapshot {
+
+private:
+    std::shared_ptr<const SnapshotOctreeNode<T>> root;  //!< root of this version
+
+public:
+    /**
+     * @brief      Constructs the object.
+     *
+     * @param[in]  _root  root of the version
+     */
+    OctreeSnapshot(const std::shared_ptr<const SnapshotOctreeNode<T>>& _root) :
+        root(_root) {}
+
+    /**
+     * @brief      find node given position
+     *
+     * @param[in]  _px   position x
+     * @param[in]  _py   position y
+     * @param[in]  _pz   position z
+     *
+     * @return     pointer to leaf
+     */
+    const SnapshotOctreeNode<T>* find_node(double _px, double _py, double _pz) const;
+
+    /**
+     * @brief      find neighbor (equal or larger in size) in direction i
+     *
+     * @param[in]  node  pointer to node
+     * @param[in]  i     direction i (OT_D_*)
+     *
+     * @return     pointer to neighbor or nullptr at the domain boundary
+     */
+    const SnapshotOctreeNode<T>* find_gteq_neighbor(const SnapshotOctreeNode<T>* node, unsigned int i) const;
+
+    /**
+     * @brief      find neighbors
+     *
+     * @param[in]  node  pointer to node
+     *
+     * @return     vector holding pointers to neighbor nodes
+     */
+    std::vector<const SnapshotOctreeNode<T>*> find_neighbors(const SnapshotOctreeNode<T>* node) const;
+
+    /**
+     * @brief      find all objects within a distance from a position
+     *
+     * @param[in]  _px   x position
+     * @param[in]  _py   y position
+     * @param[in]  _pz   z position
+     * @param[in]  r     radius
+     *
+     * @return     vector of pointers to objects
+     */
+    std::vector<T*> find_within_radius(double _px, double _py, double _pz, double r) const;
+
+    /**
+     * @brief      get the root node
+     *
+     * @return     pointer to root node
+     */
+    inline const SnapshotOctreeNode<T>* get_root() const {
+        return this->root.get();
+    }
+};
+
+/**
+ * @brief      Class for copy-on-write octree.
+ *
+ * @tparam     T     object type
+ */
+template <class T>
+class SnapshotOctree {
+
+private:
+    typedef std::shared_ptr<const SnapshotOctreeNode<T>> NodePtr;
+
+    NodePtr root;               //!< root of the current version (accessed atomically)
+    std::mutex writer;          //!< serializes updates
+
+    static const unsigned int max_level = 21;   //!< deepest level at which full leaves are split
+
+public:
+    /**
+     * @brief      Octree constructor
+     *
+     * @param[in]  _x    width of principal cell
+     * @param[in]  _y    breadth of principal cell
+     * @param[in]  _z    height of principal cell
+     */
+    SnapshotOctree(double _x, double _y, double _z);
+
+    /**
+     * @brief      add object to the tree and publish the new version
+     *
+     * @param      object  pointer to object
+     * @param[in]  _px     x position
+     * @param[in]  _py     y position
+     * @param[in]  _pz     z position
+     */
+    void add(T* object, double _px, double _py, double _pz);
+
+    /**
+     * @brief      split the leaf containing a position and publish the new
+     *             version
+     *
+     * @param[in]  _px   x position
+     * @param[in]  _py   y position
+     * @param[in]  _pz   z position
+     */
+    void split(double _px, double _py, double _pz);
+
+    /**
+     * @brief      get a consistent view on the current version
+     *
+     * @return     snapshot
+     */
+    inline OctreeSnapshot<T> snapshot() const {
+        return OctreeSnapshot<T>(std::atomic_load(&this->root));
+    }
+
+private:
+    /**
+     * @brief      copy the path towards a position and add an object to
+     *             the leaf at its end
+     *
+     * @param[in]  node    node to copy
+     * @param      object  pointer to object
+     * @param[in]  _px     x position
+     * @param[in]  _py     y position
+     * @param[in]  _pz     z position
+     *
+     * @return     copy of the node
+     */
+    static NodePtr insert(const SnapshotOctreeNode<T>& node, T* object, double _px, double _py, double _pz);
+
+    /**
+     * @brief      copy the path towards a position and split the leaf at
+     *             its end
+     *
+     * @param[in]  node  node to copy
+     * @param[in]  _px   x position
+     * @param[in]  _py   y position
+     * @param[in]  _pz   z position
+     *
+     * @return     copy of the node
+     */
+    static NodePtr split(const SnapshotOctreeNode<T>& node, double _px, double _py, double _pz);
+
+    /**
+     * @brief      distribute the objects of an unpublished leaf over 8 new
+     *             children
+     *
+     * @param      node  leaf to split
+     */
+    static void split_leaf(SnapshotOctreeNode<T>& node);
+};
+
+#include "snapshotoctree.cpp"
+
+#endif // _SNAPSHOTOCTREE_H